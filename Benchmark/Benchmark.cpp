@@ -0,0 +1,460 @@
+//Benchmark for the physics kernels, headless like the batch runner.
+//For every solver, body count and thread count it times the gravity pass, collision resolution
+//and integration separately and writes the results as JSON.
+//
+//With --accuracy it instead runs one scenario for every solver, integrator and timestep and
+//measures force error against direct summation and energy and angular momentum drift against
+//wall clock cost, the runs on the pareto front of cost against energy drift are marked.
+//
+//usage: Benchmark [--min-bodies N] [--max-bodies N] [--threads 1,2,4] [--budget seconds]
+//                 [--max-step-seconds S] [--seed S] [--out results.json]
+//       Benchmark --accuracy [--bodies N] [--dts 0.033,0.016] [--sim-time T] [--samples K]
+//                 [--threads 1,2,4] [--seed S] [--out accuracy.json]
+#include "../Gravity/Physics.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double SecondsSince(Clock::time_point t) {
+	return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+//one way of computing accelerations and overlapping pairs, new solvers get added to Solvers()
+struct Solver {
+	std::string name;
+	std::function<void(std::vector<Body2D>&, std::vector<CollisionPair>&, int)> gravity;
+	std::function<int(int, int)> threadsUsed; //threads gravity runs on for n bodies when given threads
+};
+
+static std::vector<Solver> Solvers() {
+	std::vector<Solver> solvers;
+	solvers.push_back(Solver{ "direct", [](std::vector<Body2D> &b, std::vector<CollisionPair> &pairs, int threads) {
+		Body2D::ComputeGravity(b, pairs, threads);
+	}, Body2D::GravityThreads });
+	return solvers;
+}
+
+//advances the bodies by dt, acc holds the accelerations for the current positions before and after.
+//collision pairs are left to the caller
+struct Integrator {
+	std::string name;
+	std::function<void(std::vector<Body2D>&, float, Solver&, std::vector<CollisionPair>&, int)> step;
+};
+
+static std::vector<Integrator> Integrators() {
+	std::vector<Integrator> integrators;
+	integrators.push_back(Integrator{ "euler", [](std::vector<Body2D> &b, float dt, Solver &solver, std::vector<CollisionPair> &pairs, int threads) {
+		//what the viewer does, velocity first then position with the new velocity
+		Body2D::UpdateVelandPos(b, dt);
+		solver.gravity(b, pairs, threads);
+	} });
+	integrators.push_back(Integrator{ "leapfrog", [](std::vector<Body2D> &b, float dt, Solver &solver, std::vector<CollisionPair> &pairs, int threads) {
+		int len = b.size();
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].UpdateVel(dt / 2);
+			b[counter].UpdatePos(dt);
+		}
+		solver.gravity(b, pairs, threads);
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].UpdateVel(dt / 2);
+		}
+	} });
+	return integrators;
+}
+
+struct BenchResult {
+	std::string solver;
+	int bodies = 0;
+	int threads = 1; //asked for
+	int effectiveThreads = 1; //what the solver ran on, small cases run on fewer
+	int steps = 0;
+	double interactions = 0; //summed over all steps
+	double gravitySeconds = 0, collisionSeconds = 0, integrationSeconds = 0;
+	bool skipped = false;
+	double predictedStepSeconds = 0;
+
+	double StepSeconds() { return steps > 0 ? (gravitySeconds + collisionSeconds + integrationSeconds) / steps : 0; }
+	double NsPerInteraction() { return interactions > 0 ? 1e9 * gravitySeconds / interactions : 0; }
+};
+
+struct AccuracyResult {
+	std::string solver, integrator;
+	float dt = 0;
+	int threads = 1;
+	int steps = 0;
+	double wallSeconds = 0; //physics only, the energy samples are not counted
+	double forceErrorRms = 0, forceErrorMax = 0; //relative to direct summation on the initial state
+	double energyDriftMax = 0, momentumDriftMax = 0; //largest relative drift seen
+	std::vector<double> sampleTime, energyDrift, momentumDrift;
+	bool pareto = false;
+};
+
+class Benchmark {
+public:
+	int minBodies = 100;
+	int maxBodies = 1000000;
+	std::vector<int> threadCounts;
+	double budget = 2.0; //wall seconds per case, at least one step is always run
+	double maxStepSeconds = 60; //cases predicted to take longer than this per step are skipped
+	unsigned int seed = 1;
+	std::string outPath = "benchmark.json";
+
+	//accuracy mode
+	bool accuracy = false;
+	int accuracyBodies = 1000;
+	std::vector<float> dts = { 1 / 30.0f, 1 / 60.0f, 1 / 120.0f, 1 / 240.0f };
+	double simTime = 10; //simulated seconds per run
+	int samples = 20; //energy and momentum samples per run
+
+	std::vector<BenchResult> results;
+	std::vector<AccuracyResult> accuracyResults;
+
+	bool ParseArgs(int argc, char* argv[]) {
+		int i = 1;
+		while (i < argc) {
+			std::string arg = argv[i];
+			if (arg == "--accuracy") {
+				accuracy = true;
+				outPath = "accuracy.json";
+				i++;
+				continue;
+			}
+			if (i + 1 >= argc) {
+				std::cerr << "missing value for " << arg << "\n";
+				return false;
+			}
+			std::string value = argv[i + 1];
+			i += 2;
+
+			if (arg == "--min-bodies") {
+				minBodies = std::stoi(value);
+			}
+			else if (arg == "--max-bodies") {
+				maxBodies = std::stoi(value);
+			}
+			else if (arg == "--threads") {
+				threadCounts.clear();
+				std::stringstream list(value);
+				std::string item;
+				while (std::getline(list, item, ',')) {
+					threadCounts.push_back(std::stoi(item));
+				}
+			}
+			else if (arg == "--budget") {
+				budget = std::stod(value);
+			}
+			else if (arg == "--max-step-seconds") {
+				maxStepSeconds = std::stod(value);
+			}
+			else if (arg == "--seed") {
+				seed = std::stoul(value);
+			}
+			else if (arg == "--out") {
+				outPath = value;
+			}
+			else if (arg == "--bodies") {
+				accuracyBodies = std::stoi(value);
+			}
+			else if (arg == "--dts") {
+				dts.clear();
+				std::stringstream list(value);
+				std::string item;
+				while (std::getline(list, item, ',')) {
+					dts.push_back(std::stof(item));
+				}
+			}
+			else if (arg == "--sim-time") {
+				simTime = std::stod(value);
+			}
+			else if (arg == "--samples") {
+				samples = std::max(1, std::stoi(value));
+			}
+			else {
+				std::cerr << "unknown option " << arg << "\n";
+				return false;
+			}
+		}
+
+		//powers of two up to the core count, and the core count itself
+		if (threadCounts.empty()) {
+			int cores = std::max(1u, std::thread::hardware_concurrency());
+			for (int t = 1; t < cores; t *= 2) {
+				threadCounts.push_back(t);
+			}
+			threadCounts.push_back(cores);
+		}
+		return minBodies > 1 && maxBodies >= minBodies;
+	}
+
+	void Run() {
+		for (Solver &solver : Solvers()) {
+			double nsPerInteraction = 0; //from the previous case, used to skip cases that would never finish
+			for (int n = minBodies; n <= maxBodies; n *= 10) {
+				std::vector<Body2D> scenario;
+				Body2D::InitRandomBodies(scenario, n, seed);
+
+				for (int threads : threadCounts) {
+					BenchResult r;
+					r.solver = solver.name;
+					r.bodies = n;
+					r.threads = threads;
+					r.effectiveThreads = solver.threadsUsed(n, threads);
+					r.predictedStepSeconds = nsPerInteraction * 1e-9 * n * (n - 1.0) / r.effectiveThreads;
+					if (r.predictedStepSeconds > maxStepSeconds) {
+						r.skipped = true;
+					}
+					else {
+						RunCase(solver, scenario, r);
+						if (r.effectiveThreads == 1 || nsPerInteraction == 0) {
+							nsPerInteraction = r.NsPerInteraction() * r.effectiveThreads;
+						}
+					}
+					Report(r);
+					results.push_back(r);
+				}
+				if (n > maxBodies / 10) {
+					break;
+				}
+			}
+		}
+	}
+
+	//every solver, integrator and timestep on the same scenario. merges are inelastic, so the energy
+	//and momentum they change is measured around ResolveCollisions and left out of the drift
+	void RunAccuracy() {
+		std::vector<Body2D> scenario;
+		Body2D::InitRandomBodies(scenario, accuracyBodies, seed);
+
+		//reference accelerations
+		std::vector<Body2D> reference = scenario;
+		std::vector<CollisionPair> pairs;
+		Body2D::ComputeGravity(reference, pairs, 1);
+		double e0 = Body2D::TotalEnergy(scenario);
+		double l0 = Body2D::AngularMomentum(scenario);
+
+		for (Solver &solver : Solvers()) {
+			for (Integrator &integrator : Integrators()) {
+				for (float dt : dts) {
+					for (int threads : threadCounts) {
+						AccuracyResult r;
+						r.solver = solver.name;
+						r.integrator = integrator.name;
+						r.dt = dt;
+						r.threads = threads;
+
+						std::vector<Body2D> b = scenario;
+						pairs.clear();
+						solver.gravity(b, pairs, threads);
+						ForceError(b, reference, r);
+
+						//bodies that overlap at the start merge here, before any step, which is not drift either
+						double mergeEnergy = Body2D::TotalEnergy(b), mergeMomentum = Body2D::AngularMomentum(b);
+						Body2D::ResolveCollisions(b, pairs);
+						mergeEnergy = Body2D::TotalEnergy(b) - mergeEnergy;
+						mergeMomentum = Body2D::AngularMomentum(b) - mergeMomentum;
+
+						int totalSteps = std::max(1, int(simTime / dt + 0.5));
+						int sampleEvery = std::max(1, totalSteps / samples);
+						while (r.steps < totalSteps) {
+							for (int k = 0; k < sampleEvery && r.steps < totalSteps; k++) {
+								pairs.clear();
+								Clock::time_point t = Clock::now();
+								integrator.step(b, dt, solver, pairs, threads);
+								r.wallSeconds += SecondsSince(t);
+								r.steps++;
+
+								if (!pairs.empty()) {
+									double eBefore = Body2D::TotalEnergy(b);
+									double lBefore = Body2D::AngularMomentum(b);
+									t = Clock::now();
+									Body2D::ResolveCollisions(b, pairs);
+									r.wallSeconds += SecondsSince(t);
+									mergeEnergy += Body2D::TotalEnergy(b) - eBefore;
+									mergeMomentum += Body2D::AngularMomentum(b) - lBefore;
+								}
+							}
+
+							double e = std::fabs((Body2D::TotalEnergy(b) - mergeEnergy - e0) / e0);
+							double l = (l0 != 0) ? std::fabs((Body2D::AngularMomentum(b) - mergeMomentum - l0) / l0) : 0;
+							r.sampleTime.push_back(r.steps * double(dt));
+							r.energyDrift.push_back(e);
+							r.momentumDrift.push_back(l);
+							r.energyDriftMax = std::max(r.energyDriftMax, e);
+							r.momentumDriftMax = std::max(r.momentumDriftMax, l);
+						}
+
+						std::cerr << r.solver << " " << r.integrator << " dt=" << r.dt << " threads=" << r.threads
+							<< " force error " << r.forceErrorRms << " energy drift " << r.energyDriftMax
+							<< " momentum drift " << r.momentumDriftMax << " " << r.wallSeconds << " s\n";
+						accuracyResults.push_back(r);
+					}
+				}
+			}
+		}
+		MarkPareto();
+	}
+
+	bool WriteAccuracyJson() {
+		std::ofstream out(outPath);
+		if (!out.is_open()) {
+			return false;
+		}
+		out.precision(6);
+		out << "{\n  \"benchmark\": \"accuracy\",\n  \"bodies\": " << accuracyBodies << ",\n  \"sim_time\": " << simTime
+			<< ",\n  \"seed\": " << seed << ",\n  \"merge_changes_excluded\": true,\n  \"results\": [\n";
+		for (size_t i = 0; i < accuracyResults.size(); i++) {
+			AccuracyResult &r = accuracyResults[i];
+			out << "    {\"solver\": \"" << r.solver << "\", \"integrator\": \"" << r.integrator << "\", \"dt\": " << r.dt
+				<< ", \"threads\": " << r.threads << ", \"steps\": " << r.steps << ", \"wall_seconds\": " << r.wallSeconds
+				<< ", \"force_error_rms\": " << r.forceErrorRms << ", \"force_error_max\": " << r.forceErrorMax
+				<< ", \"energy_drift_max\": " << r.energyDriftMax << ", \"angular_momentum_drift_max\": " << r.momentumDriftMax
+				<< ", \"pareto\": " << (r.pareto ? "true" : "false") << ",\n      \"drift\": [";
+			for (size_t k = 0; k < r.sampleTime.size(); k++) {
+				out << (k ? ", " : "") << "[" << r.sampleTime[k] << ", " << r.energyDrift[k] << ", " << r.momentumDrift[k] << "]";
+			}
+			out << "]}" << (i + 1 < accuracyResults.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+		return true;
+	}
+
+	bool WriteJson() {
+		std::ofstream out(outPath);
+		if (!out.is_open()) {
+			return false;
+		}
+		out.precision(6);
+		out << "{\n  \"benchmark\": \"physics\",\n  \"hardware_threads\": " << std::thread::hardware_concurrency()
+			<< ",\n  \"seed\": " << seed << ",\n  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			BenchResult &r = results[i];
+			out << "    {\"solver\": \"" << r.solver << "\", \"bodies\": " << r.bodies << ", \"threads\": " << r.threads
+				<< ", \"effective_threads\": " << r.effectiveThreads;
+			if (r.skipped) {
+				out << ", \"skipped\": true, \"predicted_step_seconds\": " << r.predictedStepSeconds << "}";
+			}
+			else {
+				out << ", \"steps\": " << r.steps
+					<< ", \"gravity_ms\": " << 1000 * r.gravitySeconds / r.steps
+					<< ", \"collisions_ms\": " << 1000 * r.collisionSeconds / r.steps
+					<< ", \"integration_ms\": " << 1000 * r.integrationSeconds / r.steps
+					<< ", \"ns_per_interaction\": " << r.NsPerInteraction()
+					<< ", \"steps_per_second\": " << 1 / r.StepSeconds()
+					<< ", \"scaling_efficiency\": " << ScalingEfficiency(r) << "}";
+			}
+			out << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+		return true;
+	}
+
+private:
+	//steps a copy of the scenario until the time budget is used up
+	void RunCase(Solver &solver, std::vector<Body2D> &scenario, BenchResult &r) {
+		std::vector<Body2D> b = scenario;
+		std::vector<CollisionPair> pairs;
+		float dt = 1 / 60.0f;
+
+		Clock::time_point start = Clock::now();
+		while (r.steps == 0 || SecondsSince(start) < budget) {
+			double n = b.size();
+			pairs.clear();
+
+			Clock::time_point t = Clock::now();
+			solver.gravity(b, pairs, r.threads);
+			r.gravitySeconds += SecondsSince(t);
+
+			t = Clock::now();
+			Body2D::ResolveCollisions(b, pairs);
+			r.collisionSeconds += SecondsSince(t);
+
+			t = Clock::now();
+			Body2D::UpdateVelandPos(b, dt);
+			r.integrationSeconds += SecondsSince(t);
+
+			r.interactions += n * (n - 1);
+			r.steps++;
+		}
+	}
+
+	//relative error of every body's acceleration against the reference, rms and max
+	void ForceError(std::vector<Body2D> &b, std::vector<Body2D> &reference, AccuracyResult &r) {
+		double sum = 0;
+		int len = b.size();
+		for (int counter = 0; counter < len; counter++) {
+			Vec2D diff = Vec2D(b[counter].acc.x - reference[counter].acc.x, b[counter].acc.y - reference[counter].acc.y);
+			double refMag = reference[counter].acc.mag();
+			double err = (refMag > 0) ? diff.mag() / refMag : diff.mag();
+			sum += err * err;
+			r.forceErrorMax = std::max(r.forceErrorMax, err);
+		}
+		r.forceErrorRms = len > 0 ? std::sqrt(sum / len) : 0;
+	}
+
+	//a run is on the front if no other run is both cheaper and drifts less
+	void MarkPareto() {
+		for (AccuracyResult &r : accuracyResults) {
+			r.pareto = true;
+			for (AccuracyResult &other : accuracyResults) {
+				bool noWorse = other.wallSeconds <= r.wallSeconds && other.energyDriftMax <= r.energyDriftMax;
+				bool better = other.wallSeconds < r.wallSeconds || other.energyDriftMax < r.energyDriftMax;
+				if (&other != &r && noWorse && better) {
+					r.pareto = false;
+					break;
+				}
+			}
+		}
+	}
+
+	//speedup over the single thread run of the same case divided by the threads it really ran on
+	double ScalingEfficiency(BenchResult &r) {
+		for (BenchResult &single : results) {
+			if (single.solver == r.solver && single.bodies == r.bodies && single.effectiveThreads == 1 && !single.skipped) {
+				return single.StepSeconds() / (r.StepSeconds() * r.effectiveThreads);
+			}
+		}
+		return 0;
+	}
+
+	void Report(BenchResult &r) {
+		std::cerr << r.solver << " n=" << r.bodies << " threads=" << r.threads;
+		if (r.effectiveThreads != r.threads) {
+			std::cerr << " (ran on " << r.effectiveThreads << ")";
+		}
+		if (r.skipped) {
+			std::cerr << " skipped, predicted " << r.predictedStepSeconds << " s/step\n";
+		}
+		else {
+			std::cerr << " " << r.steps << " steps, " << r.NsPerInteraction() << " ns/interaction, "
+				<< 1 / r.StepSeconds() << " steps/s\n";
+		}
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	Benchmark bench;
+	if (!bench.ParseArgs(argc, argv)) {
+		std::cerr << "usage: Benchmark [--min-bodies N] [--max-bodies N] [--threads 1,2,4] [--budget seconds]\n"
+			<< "                 [--max-step-seconds S] [--seed S] [--out results.json]\n"
+			<< "       Benchmark --accuracy [--bodies N] [--dts 0.033,0.016] [--sim-time T] [--samples K]\n"
+			<< "                 [--threads 1,2,4] [--seed S] [--out accuracy.json]\n";
+		return 1;
+	}
+	if (bench.accuracy) {
+		bench.RunAccuracy();
+	}
+	else {
+		bench.Run();
+	}
+	if (!(bench.accuracy ? bench.WriteAccuracyJson() : bench.WriteJson())) {
+		std::cerr << "could not write " << bench.outPath << "\n";
+		return 1;
+	}
+	return 0;
+}
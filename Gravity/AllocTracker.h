@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+//Counts heap allocations per profiler phase, opt in by building with -DGRAVITY_TRACK_ALLOCATIONS.
+//The global operator new/delete replacements are compiled into the one file that defines
+//ALLOC_TRACKER_APPLICATION before including this header, the same way OLC_PGE_APPLICATION works.
+//Without the flag nothing is hooked and every count stays zero.
+//
+//Profiler::Scope sets the calling thread's phase, so an allocation is charged to the innermost open scope.
+//Threads that never called Profiler::AttachThread (physics workers, recorder and telemetry threads, the olc event
+//loop) share OTHER_THREADS.
+//Over-aligned new (alignas above the default) goes through the unreplaced aligned overloads and is not counted.
+namespace AllocTracker {
+
+#if defined(GRAVITY_TRACK_ALLOCATIONS)
+	const bool ENABLED = true;
+#else
+	const bool ENABLED = false;
+#endif
+
+	const int MAX_PHASES = 62;
+	const int OTHER_THREADS = -2;
+	const int NO_SCOPE = -1; //the profiler's attached thread outside every scope
+
+	struct Counts {
+		std::atomic<uint64_t> allocs;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> frees;
+	};
+
+	//bucket 0 is OTHER_THREADS, 1 is NO_SCOPE, phase p is p + 2
+	inline Counts* Buckets() {
+		static Counts buckets[MAX_PHASES + 2]; //static storage, zeroed before any allocation can happen
+		return buckets;
+	}
+
+	inline int Bucket(int phase) {
+		return (phase >= MAX_PHASES) ? NO_SCOPE + 2 : phase + 2;
+	}
+
+	inline int& CurrentPhase() {
+		thread_local int phase = OTHER_THREADS;
+		return phase;
+	}
+
+	inline void RecordAlloc(size_t size) {
+		Counts &c = Buckets()[Bucket(CurrentPhase())];
+		c.allocs.fetch_add(1, std::memory_order_relaxed);
+		c.bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	inline void RecordFree() {
+		Buckets()[Bucket(CurrentPhase())].frees.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+#if defined(GRAVITY_TRACK_ALLOCATIONS) && defined(ALLOC_TRACKER_APPLICATION)
+#undef ALLOC_TRACKER_APPLICATION
+
+void* operator new(std::size_t size) {
+	AllocTracker::RecordAlloc(size);
+	void* p = std::malloc(size == 0 ? 1 : size);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	AllocTracker::RecordAlloc(size);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+	if (p != nullptr) {
+		AllocTracker::RecordFree();
+		std::free(p);
+	}
+}
+
+void operator delete[](void* p) noexcept {
+	operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+	operator delete(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+	operator delete(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+	operator delete(p);
+}
+
+#endif
@@ -0,0 +1,329 @@
+#pragma once
+#include "SpscRing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <png.h>
+#endif
+
+//Writes rendered frames to disk on background threads, as a png sequence or as one raw y4m video.
+//Submit() copies the frame into a buffer allocated at Open() and hands it to an encoder, it does not wait on disk or
+//compression unless the policy says so. Every encoder has a ring of its own buffers and frames go to them in turn,
+//so pngs compress in parallel. Y4M frames are converted in parallel as well, then written in the order they came.
+//
+//	path ending in .y4m:	one YUV4MPEG2 4:2:0 stream, ffmpeg -i run.y4m run.mp4
+//	any other path:			path_000000.png, path_000001.png, ... through libpng, so linux only
+namespace Capture {
+
+	enum Policy {
+		DROP, //a frame that finds every buffer busy is not captured
+		THROTTLE, //every n-th frame, n doubles while the encoders fall behind and halves again once they catch up
+		WAIT //waits for a free buffer, for offscreen runs where every frame matters
+	};
+
+	const int DEFAULT_BUFFERS = 8;
+	const int MAX_STRIDE = 64;
+	const int PNG_LEVEL = 1; //zlib level, size matters less than keeping up
+
+	struct Options {
+		Policy policy = DROP;
+		int every = 1; //capture every n-th frame, where THROTTLE starts and the least it throttles to
+		int buffers = DEFAULT_BUFFERS; //frames waiting or being encoded at once
+		int encoders = 0; //0 for half the hardware threads
+		int fps = 60; //for the y4m header
+	};
+
+	//one captured frame, the buffers keep their storage between frames
+	struct Frame {
+		uint64_t sequence = 0; //captured frames count from 0 without gaps
+		int width = 0, height = 0;
+		std::vector<uint32_t> pixels; //olc::Pixel layout, red in the low byte
+	};
+
+	inline bool EndsWith(const std::string &s, const std::string &suffix) {
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	class Exporter {
+	public:
+		Exporter() = default;
+		Exporter(const Exporter&) = delete; //owns the encoder threads and the file
+		Exporter& operator=(const Exporter&) = delete;
+
+		~Exporter() {
+			Close();
+		}
+
+		//frames must be width x height from now on, others are dropped
+		bool Open(const std::string &path, int width, int height, const Options &options = Options()) {
+			Close();
+			if (width <= 0 || height <= 0) {
+				return false;
+			}
+			this->path = path;
+			this->width = width;
+			this->height = height;
+			this->options = options;
+			this->options.every = std::max(1, options.every);
+			y4m = EndsWith(path, ".y4m");
+#if !defined(__linux__)
+			if (!y4m) {
+				return false; //no png writer here
+			}
+#endif
+			if (y4m) {
+				video = fopen(path.c_str(), "wb");
+				if (video == nullptr) {
+					return false;
+				}
+				char header[128];
+				int len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, std::max(1, options.fps));
+				fwrite(header, 1, len, video);
+				bytesWritten = len;
+			}
+			else {
+				bytesWritten = 0;
+			}
+
+			int threads = options.encoders > 0 ? options.encoders : std::max(1u, std::thread::hardware_concurrency() / 2);
+			threads = std::max(1, std::min(threads, std::max(1, options.buffers)));
+			Frame prototype;
+			prototype.width = width;
+			prototype.height = height;
+			prototype.pixels.resize(size_t(width) * height);
+			size_t perEncoder = std::max(1, options.buffers / threads);
+			slots = perEncoder * threads;
+			for (int counter = 0; counter < threads; counter++) {
+				encoders.push_back(std::unique_ptr<Encoder>(new Encoder(perEncoder, prototype)));
+			}
+
+			stride = this->options.every;
+			sinceCapture = stride - 1; //the first frame is always taken
+			nextEncoder = 0;
+			captured = 0;
+			completed = 0;
+			nextWrite = 0;
+			framesDropped = 0;
+			framesSkipped = 0;
+			framesFailed = 0;
+			running = true;
+			for (std::unique_ptr<Encoder> &e : encoders) {
+				e->thread = std::thread(&Exporter::EncoderThread, this, e.get());
+			}
+			return true;
+		}
+
+		//encodes everything still queued, then closes the file
+		void Close() {
+			if (encoders.empty()) {
+				return;
+			}
+			running = false;
+			for (std::unique_ptr<Encoder> &e : encoders) {
+				e->thread.join();
+			}
+			encoders.clear();
+			if (video != nullptr) {
+				fclose(video);
+				video = nullptr;
+			}
+		}
+
+		bool IsOpen() {
+			return !encoders.empty();
+		}
+
+		//called from the render thread once per frame, true if this frame was taken
+		bool Submit(const uint32_t* pixels, int width, int height) {
+			if (encoders.empty() || pixels == nullptr) {
+				return false;
+			}
+			if (width != this->width || height != this->height) {
+				framesDropped++;
+				return false;
+			}
+			if (options.policy == THROTTLE) {
+				uint64_t busy = captured - completed;
+				if (busy * 2 > slots) {
+					stride = std::min(stride * 2, MAX_STRIDE);
+				}
+				else if (busy == 0 && stride > options.every) {
+					stride = std::max(stride / 2, options.every);
+				}
+			}
+			if (++sinceCapture < stride) {
+				framesSkipped++;
+				return false;
+			}
+
+			Frame* f = nullptr;
+			size_t which = 0;
+			while (f == nullptr) {
+				for (size_t counter = 0; counter < encoders.size() && f == nullptr; counter++) {
+					which = (nextEncoder + counter) % encoders.size();
+					f = encoders[which]->queue.BeginPush();
+				}
+				if (f == nullptr && options.policy != WAIT) {
+					framesDropped++;
+					return false;
+				}
+				if (f == nullptr) {
+					std::this_thread::yield();
+				}
+			}
+			sinceCapture = 0;
+			f->sequence = captured;
+			memcpy(f->pixels.data(), pixels, f->pixels.size() * sizeof(uint32_t));
+			encoders[which]->queue.CommitPush();
+			nextEncoder = (which + 1) % encoders.size();
+			captured++;
+			return true;
+		}
+
+		uint64_t FramesCaptured() { return captured; }
+		uint64_t FramesDropped() { return framesDropped; } //no free buffer, or the wrong size
+		uint64_t FramesSkipped() { return framesSkipped; } //left out by every or THROTTLE
+		uint64_t FramesFailed() { return framesFailed; } //could not be written
+		uint64_t BytesWritten() { return bytesWritten; }
+		int Stride() { return stride; }
+
+	private:
+		struct Encoder {
+			SpscRing<Frame> queue;
+			std::thread thread;
+			std::vector<uint8_t> yuv; //y4m only
+			std::vector<uint8_t> row; //png only
+
+			Encoder(size_t buffers, const Frame &prototype) : queue(buffers, prototype) {}
+		};
+
+		std::string path;
+		int width = 0, height = 0;
+		Options options;
+		bool y4m = false;
+		FILE* video = nullptr;
+		std::vector<std::unique_ptr<Encoder>> encoders;
+		uint64_t slots = 0; //buffers over all encoders
+		std::atomic<bool> running{ false };
+
+		//render thread only
+		int stride = 1;
+		int sinceCapture = 0;
+		size_t nextEncoder = 0;
+		uint64_t framesDropped = 0, framesSkipped = 0;
+
+		std::atomic<uint64_t> captured{ 0 };
+		std::atomic<uint64_t> completed{ 0 };
+		std::atomic<uint64_t> nextWrite{ 0 }; //sequence of the next y4m frame to go into the file
+		std::atomic<uint64_t> framesFailed{ 0 };
+		std::atomic<uint64_t> bytesWritten{ 0 };
+
+		void EncoderThread(Encoder* e) {
+			while (true) {
+				bool stopping = !running; //read before the queue so frames pushed before Close() are never lost
+				Frame* f = e->queue.Front();
+				if (f == nullptr) {
+					if (stopping) {
+						break;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				bool ok = y4m ? WriteY4M(*f, *e) : WritePNG(*f, *e);
+				if (!ok) {
+					framesFailed++;
+				}
+				e->queue.Pop();
+				completed++;
+			}
+		}
+
+		//bt.601 studio range, chroma is the average of each 2x2 block
+		bool WriteY4M(const Frame &f, Encoder &e) {
+			int cw = (f.width + 1) / 2, ch = (f.height + 1) / 2;
+			size_t lumaBytes = size_t(f.width) * f.height, chromaBytes = size_t(cw) * ch;
+			e.yuv.resize(lumaBytes + 2 * chromaBytes);
+			uint8_t* yPlane = e.yuv.data();
+			uint8_t* uPlane = yPlane + lumaBytes;
+			uint8_t* vPlane = uPlane + chromaBytes;
+			for (int y = 0; y < f.height; y++) {
+				const uint32_t* in = f.pixels.data() + size_t(y) * f.width;
+				for (int x = 0; x < f.width; x++) {
+					int r = in[x] & 0xFF, g = (in[x] >> 8) & 0xFF, b = (in[x] >> 16) & 0xFF;
+					yPlane[size_t(y) * f.width + x] = uint8_t(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+				}
+			}
+			for (int cy = 0; cy < ch; cy++) {
+				for (int cx = 0; cx < cw; cx++) {
+					int r = 0, g = 0, b = 0, n = 0;
+					for (int y = 2 * cy; y < std::min(2 * cy + 2, f.height); y++) {
+						for (int x = 2 * cx; x < std::min(2 * cx + 2, f.width); x++) {
+							uint32_t p = f.pixels[size_t(y) * f.width + x];
+							r += p & 0xFF; g += (p >> 8) & 0xFF; b += (p >> 16) & 0xFF;
+							n++;
+						}
+					}
+					r /= n; g /= n; b /= n;
+					uPlane[size_t(cy) * cw + cx] = uint8_t(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+					vPlane[size_t(cy) * cw + cx] = uint8_t(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+				}
+			}
+
+			//sequences only grow inside each ring, so the frame that is due is at the front of some encoder
+			while (nextWrite != f.sequence) {
+				std::this_thread::yield();
+			}
+			bool ok = fwrite("FRAME\n", 1, 6, video) == 6 && fwrite(e.yuv.data(), 1, e.yuv.size(), video) == e.yuv.size();
+			bytesWritten += 6 + e.yuv.size();
+			nextWrite++;
+			return ok;
+		}
+
+		bool WritePNG(const Frame &f, Encoder &e) {
+#if defined(__linux__)
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), "_%06llu.png", (unsigned long long)f.sequence);
+			std::string name = path + suffix;
+			FILE* file = fopen(name.c_str(), "wb");
+			if (file == nullptr) {
+				return false;
+			}
+			png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+			png_infop info = png != nullptr ? png_create_info_struct(png) : nullptr;
+			if (png == nullptr || info == nullptr || setjmp(png_jmpbuf(png))) {
+				png_destroy_write_struct(&png, &info);
+				fclose(file);
+				return false;
+			}
+			png_init_io(png, file);
+			png_set_compression_level(png, PNG_LEVEL);
+			png_set_IHDR(png, info, f.width, f.height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+			png_write_info(png, info);
+			e.row.resize(size_t(f.width) * 3);
+			for (int y = 0; y < f.height; y++) {
+				const uint32_t* in = f.pixels.data() + size_t(y) * f.width;
+				for (int x = 0; x < f.width; x++) {
+					e.row[3 * x] = uint8_t(in[x]);
+					e.row[3 * x + 1] = uint8_t(in[x] >> 8);
+					e.row[3 * x + 2] = uint8_t(in[x] >> 16);
+				}
+				png_write_row(png, e.row.data());
+			}
+			png_write_end(png, nullptr);
+			png_destroy_write_struct(&png, &info);
+			bytesWritten += uint64_t(ftell(file));
+			return fclose(file) == 0;
+#else
+			return false;
+#endif
+		}
+	};
+}
@@ -0,0 +1,970 @@
+#pragma once
+#include "Physics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+//One simulation split over several processes by orthogonal recursive bisection (ORB) of space.
+//Every rank owns the bodies inside its box and integrates only those. Each step the ranks swap a halo:
+//the bodies of every other domain, or just its total mass and centre of mass when the two domains are far
+//enough apart (theta, the Barnes-Hut opening test applied to whole domains, 0 sends every body, no monopoles).
+//Bodies in far domains are never tested for overlap, so keep theta well below 1.
+//Bodies that drift out of their box travel to their new owner in the same message.
+//Overlapping pairs are swapped as well, so every rank replays the same merges in the same order. That order is by
+//body id, not the row order of Body2D::ResolveCollisions, and rows differ from a single process once merges have
+//swap-removed bodies, so a run agrees across its ranks but drifts from a one process run after the first merge.
+//
+//The ranks measure their cpu time per step, and when the slowest is more than rebalanceTolerance above
+//the mean over rebalanceEvery steps the boxes are cut again with every body weighted by its rank's cost.
+//
+//Ranks are forked on one host and connected all to all by Unix domain socket pairs. Mesh only needs
+//a connected stream socket per pair of ranks, so TCP sockets between nodes would slot in unchanged.
+//Messages carry raw structs, every rank must run the same binary on the same architecture.
+namespace Domain {
+
+	struct Box {
+		float x0, y0, x1, y1; //[x0, x1) x [y0, y1), the outer boxes reach infinity
+
+		bool Contains(float x, float y) const {
+			return x >= x0 && x < x1 && y >= y0 && y < y1;
+		}
+	};
+
+	struct WeightedPoint {
+		float x, y, weight;
+	};
+
+	//cuts [begin, end) across the longer side of its extent so the halves carry weight in proportion to their parts
+	inline void BisectRange(std::vector<WeightedPoint> &p, size_t begin, size_t end, int parts, Box box, std::vector<Box> &boxes) {
+		if (parts == 1) {
+			boxes.push_back(box);
+			return;
+		}
+		int left = parts / 2;
+
+		float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+		double total = 0;
+		for (size_t counter = begin; counter < end; counter++) {
+			minX = std::min(minX, p[counter].x);
+			maxX = std::max(maxX, p[counter].x);
+			minY = std::min(minY, p[counter].y);
+			maxY = std::max(maxY, p[counter].y);
+			total += p[counter].weight;
+		}
+		bool alongX = begin == end || maxX - minX >= maxY - minY;
+		auto key = [alongX](const WeightedPoint &a) { return alongX ? a.x : a.y; };
+		std::sort(p.begin() + begin, p.begin() + end, [&key](const WeightedPoint &a, const WeightedPoint &b) { return key(a) < key(b); });
+
+		float cut;
+		if (begin == end) {
+			//nothing to balance, any cut inside the box will do
+			cut = alongX ? std::min(std::max(0.0f, box.x0), box.x1) : std::min(std::max(0.0f, box.y0), box.y1);
+		}
+		else {
+			double target = total * left / parts;
+			double sum = 0;
+			size_t k = begin;
+			while (k < end && sum + p[k].weight <= target) {
+				sum += p[k].weight;
+				k++;
+			}
+			if (k < end && target - sum > sum + p[k].weight - target) {
+				k++;
+			}
+			cut = k < end ? key(p[k]) : std::nextafter(key(p[end - 1]), INFINITY);
+		}
+
+		size_t mid = begin;
+		while (mid < end && key(p[mid]) < cut) {
+			mid++;
+		}
+		Box lo = box, hi = box;
+		if (alongX) {
+			lo.x1 = cut;
+			hi.x0 = cut;
+		}
+		else {
+			lo.y1 = cut;
+			hi.y0 = cut;
+		}
+		BisectRange(p, begin, mid, left, lo, boxes);
+		BisectRange(p, mid, end, parts - left, hi, boxes);
+	}
+
+	//parts boxes covering the plane, in rank order. the same points in the same order give the same boxes on every rank
+	inline std::vector<Box> Bisect(std::vector<WeightedPoint> points, int parts) {
+		std::vector<Box> boxes;
+		float inf = std::numeric_limits<float>::infinity();
+		BisectRange(points, 0, points.size(), parts, Box{ -inf, -inf, inf, inf }, boxes);
+		return boxes;
+	}
+
+	//bytes in and out of a message, read back in the order they were written
+	struct Buffer {
+		std::vector<char> data;
+		size_t read = 0;
+
+		template<typename T> void Put(const T &value) {
+			static_assert(std::is_trivially_copyable<T>::value, "messages carry raw bytes");
+			size_t at = data.size();
+			data.resize(at + sizeof(T));
+			memcpy(&data[at], &value, sizeof(T));
+		}
+
+		template<typename T> T Get() {
+			T value;
+			memcpy(&value, &data[read], sizeof(T));
+			read += sizeof(T);
+			return value;
+		}
+
+		void Clear() {
+			data.clear();
+			read = 0;
+		}
+	};
+
+	//one stream socket to every other rank
+	class Mesh {
+	public:
+		int rank = 0, size = 1;
+		uint64_t bytesSent = 0;
+
+		~Mesh() {
+			Close();
+		}
+
+		//forks processes - 1 children connected all to all, returns in every process with rank set.
+		//flush stdout before calling or buffered output is printed once per rank
+		bool Launch(int processes) {
+#if defined(__linux__)
+			size = processes;
+			std::vector<int> pairFds(size * size, -1); //[i * size + j] is i's end of the socket between i and j
+			for (int i = 0; i < size; i++) {
+				for (int j = i + 1; j < size; j++) {
+					int sv[2];
+					if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+						CloseAll(pairFds);
+						return false;
+					}
+					pairFds[i * size + j] = sv[0];
+					pairFds[j * size + i] = sv[1];
+				}
+			}
+
+			rank = 0;
+			for (int r = 1; r < size; r++) {
+				pid_t pid = fork();
+				if (pid < 0) {
+					CloseAll(pairFds);
+					Reap();
+					return false;
+				}
+				if (pid == 0) {
+					rank = r;
+					children.clear();
+					break;
+				}
+				children.push_back(pid);
+			}
+
+			fds.assign(size, -1);
+			for (int p = 0; p < size; p++) {
+				fds[p] = pairFds[rank * size + p];
+				pairFds[rank * size + p] = -1;
+				if (fds[p] >= 0) {
+					fcntl(fds[p], F_SETFL, fcntl(fds[p], F_GETFL) | O_NONBLOCK);
+				}
+			}
+			CloseAll(pairFds);
+			return true;
+#else
+			(void)processes;
+			return false;
+#endif
+		}
+
+		//sends out[p] to every other rank p and fills in[p] with what p sent here, every rank calls it together.
+		//all sockets are serviced at once so no pair of ranks can block each other on full buffers
+		bool Exchange(std::vector<Buffer> &out, std::vector<Buffer> &in) {
+#if defined(__linux__)
+			struct Transfer {
+				uint64_t length = 0, header = 0; //header is how much of our own length prefix went out
+				size_t done = 0;
+				uint64_t inLength = 0, inHeader = 0;
+				size_t inDone = 0;
+			};
+			std::vector<Transfer> t(size);
+			std::vector<pollfd> polls;
+			int pending = 0;
+			for (int p = 0; p < size; p++) {
+				in[p].Clear();
+				if (p != rank) {
+					t[p].length = out[p].data.size();
+					pending += 2;
+				}
+			}
+
+			while (pending > 0) {
+				polls.clear();
+				for (int p = 0; p < size; p++) {
+					if (p == rank) {
+						continue;
+					}
+					short events = 0;
+					if (t[p].header < 8 || t[p].done < t[p].length) {
+						events |= POLLOUT;
+					}
+					if (t[p].inHeader < 8 || t[p].inDone < t[p].inLength) {
+						events |= POLLIN;
+					}
+					if (events != 0) {
+						polls.push_back(pollfd{ fds[p], events, 0 });
+					}
+				}
+				if (poll(polls.data(), polls.size(), -1) < 0) {
+					return false;
+				}
+
+				for (pollfd &pf : polls) {
+					int p = int(std::find(fds.begin(), fds.end(), pf.fd) - fds.begin());
+					Transfer &x = t[p];
+					if (pf.revents & POLLOUT) {
+						ssize_t n;
+						if (x.header < 8) {
+							n = send(pf.fd, (char*)&x.length + x.header, 8 - x.header, MSG_NOSIGNAL);
+							if (n > 0) {
+								x.header += n;
+							}
+						}
+						else {
+							n = send(pf.fd, out[p].data.data() + x.done, x.length - x.done, MSG_NOSIGNAL);
+							if (n > 0) {
+								x.done += n;
+							}
+						}
+						if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+							return false;
+						}
+						bytesSent += n > 0 ? n : 0;
+						if (x.header == 8 && x.done == x.length) {
+							pending--;
+						}
+					}
+					if (pf.revents & (POLLIN | POLLHUP | POLLERR)) {
+						ssize_t n;
+						if (x.inHeader < 8) {
+							n = recv(pf.fd, (char*)&x.inLength + x.inHeader, 8 - x.inHeader, 0);
+							if (n > 0) {
+								x.inHeader += n;
+								if (x.inHeader == 8) {
+									in[p].data.resize(x.inLength);
+								}
+							}
+						}
+						else {
+							n = recv(pf.fd, in[p].data.data() + x.inDone, x.inLength - x.inDone, 0);
+							if (n > 0) {
+								x.inDone += n;
+							}
+						}
+						if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+							return false; //a rank went away
+						}
+						if (x.inHeader == 8 && x.inDone == x.inLength) {
+							pending--;
+						}
+					}
+				}
+			}
+			return true;
+#else
+			(void)out;
+			(void)in;
+			return false;
+#endif
+		}
+
+		//the parent waits for every child and returns 1 if any failed, a child ends its process here
+		int Finish(int code) {
+			Close();
+#if defined(__linux__)
+			if (rank != 0) {
+				_exit(code);
+			}
+			return Reap() ? code : 1;
+#else
+			return code;
+#endif
+		}
+
+	private:
+		std::vector<int> fds;
+		std::vector<int> children; //pids, only in rank 0
+
+		void Close() {
+#if defined(__linux__)
+			CloseAll(fds);
+#endif
+		}
+
+#if defined(__linux__)
+		static void CloseAll(std::vector<int> &list) {
+			for (int &fd : list) {
+				if (fd >= 0) {
+					close(fd);
+				}
+				fd = -1;
+			}
+		}
+
+		bool Reap() {
+			bool ok = true;
+			for (pid_t pid : children) {
+				int status = 0;
+				if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					ok = false;
+				}
+			}
+			children.clear();
+			return ok;
+		}
+#endif
+	};
+
+	//what a rank sends of a body in the halo, velocities are only needed for merges and travel with the pairs
+	struct HaloBody {
+		uint32_t id;
+		float x, y;
+		int32_t mass, radius;
+	};
+
+	//a whole far domain
+	struct Monopole {
+		float x, y, mass;
+	};
+
+	//two overlapping bodies by id, lo < hi
+	struct IdPair {
+		uint32_t lo, hi;
+
+		bool operator<(const IdPair &other) const {
+			return lo < other.lo || (lo == other.lo && hi < other.hi);
+		}
+		bool operator==(const IdPair &other) const {
+			return lo == other.lo && hi == other.hi;
+		}
+	};
+
+	//what a merge needs of a body
+	struct MergeState {
+		uint32_t id;
+		float vx, vy;
+		int32_t mass, radius;
+	};
+
+	static_assert(std::is_trivially_copyable<Body2D>::value, "migrating bodies are sent as raw bytes");
+
+	//one rank's share of the simulation. every public method except Rank() is collective:
+	//all ranks call it in the same order or the exchange inside blocks forever
+	class Simulation {
+	public:
+		float theta = 0; //domain opening angle, 0 sends every body and gives the direct sum
+		uint64_t rebalanceEvery = 50; //steps between load checks, 0 never rebalances
+		float rebalanceTolerance = 0.1f;
+		const char* status = "finished"; //finished, collided, ejected or failed
+
+		//filled on rank 0 by Gather
+		std::vector<int> rankBodies;
+		uint64_t migrated = 0, rebalances = 0, bytesSent = 0;
+
+		bool Launch(int processes) {
+			if (!mesh.Launch(processes)) {
+				return false;
+			}
+			out.resize(mesh.size);
+			in.resize(mesh.size);
+			windowSeconds.assign(mesh.size, 0);
+			poles.assign(mesh.size, Monopole{ 0, 0, 0 });
+			extents.assign(mesh.size, INFINITY); //nothing is far until every rank has reported once
+			return true;
+		}
+
+		int Rank() { return mesh.rank; }
+
+		//every rank passes the same bodies and keeps those in its box, ids are the indices into all
+		void Init(const std::vector<Body2D> &all) {
+			std::vector<WeightedPoint> points;
+			for (const Body2D &body : all) {
+				points.push_back(WeightedPoint{ body.pos.x, body.pos.y, 1 });
+			}
+			boxes = Bisect(points, mesh.size);
+			own.clear();
+			ids.clear();
+			for (size_t counter = 0; counter < all.size(); counter++) {
+				if (boxes[mesh.rank].Contains(all[counter].pos.x, all[counter].pos.y)) {
+					own.push_back(all[counter]);
+					ids.push_back(uint32_t(counter));
+				}
+			}
+		}
+
+		//accelerations for the starting positions, leapfrog needs them before the first kick
+		bool Start(bool stopOnCollision) {
+			if (!ExchangeHalo() || !ComputeForces() || !ExchangePairs()) {
+				return Fail();
+			}
+			if (stopOnCollision && !pairs.empty()) {
+				status = "collided";
+				return false;
+			}
+			Resolve();
+			return true;
+		}
+
+		//one step in the order Simulate() uses, false once the run has stopped
+		bool Step(float dt, bool leapfrog, bool stopOnCollision, float ejectRadius) {
+			double start = CpuSeconds();
+			if (leapfrog) {
+				for (Body2D &body : own) {
+					body.UpdateVel(dt / 2);
+					body.UpdatePos(dt);
+				}
+			}
+			if (!ExchangeHalo() || !ComputeForces()) {
+				return Fail();
+			}
+			if (leapfrog) {
+				for (Body2D &body : own) {
+					body.UpdateVel(dt / 2);
+				}
+			}
+			if (!ExchangePairs()) {
+				return Fail();
+			}
+			if (stopOnCollision && !pairs.empty()) {
+				status = "collided";
+				return false;
+			}
+			Resolve();
+			if (!leapfrog) {
+				Body2D::UpdateVelandPos(own, dt);
+			}
+			stepSeconds = CpuSeconds() - start;
+
+			if (ejectRadius > 0) {
+				bool ejected;
+				if (!Ejected(ejectRadius, ejected)) {
+					return Fail();
+				}
+				if (ejected) {
+					status = "ejected";
+					return false;
+				}
+			}
+
+			steps++;
+			if (rebalanceEvery > 0 && steps % rebalanceEvery == 0 && !CheckBalance()) {
+				return Fail();
+			}
+			return true;
+		}
+
+		//rank 0 gets every body ordered by id, the other ranks leave all untouched
+		bool Gather(std::vector<Body2D> &all) {
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+			}
+			if (mesh.rank != 0) {
+				Buffer &m = out[0];
+				m.Put(migratedHere);
+				m.Put(mesh.bytesSent);
+				m.Put(uint32_t(own.size()));
+				for (size_t counter = 0; counter < own.size(); counter++) {
+					m.Put(ids[counter]);
+					m.Put(own[counter]);
+				}
+			}
+			if (!mesh.Exchange(out, in)) {
+				return Fail();
+			}
+			if (mesh.rank != 0) {
+				return true;
+			}
+
+			std::vector<std::pair<uint32_t, Body2D>> byId;
+			rankBodies.assign(mesh.size, 0);
+			migrated = migratedHere;
+			bytesSent = mesh.bytesSent;
+			for (int p = 0; p < mesh.size; p++) {
+				if (p == mesh.rank) {
+					for (size_t counter = 0; counter < own.size(); counter++) {
+						byId.push_back(std::make_pair(ids[counter], own[counter]));
+					}
+					rankBodies[p] = int(own.size());
+					continue;
+				}
+				Buffer &m = in[p];
+				migrated += m.Get<uint64_t>();
+				bytesSent += m.Get<uint64_t>();
+				uint32_t count = m.Get<uint32_t>();
+				rankBodies[p] = int(count);
+				for (uint32_t counter = 0; counter < count; counter++) {
+					uint32_t id = m.Get<uint32_t>();
+					byId.push_back(std::make_pair(id, m.Get<Body2D>()));
+				}
+			}
+			std::sort(byId.begin(), byId.end(), [](const std::pair<uint32_t, Body2D> &a, const std::pair<uint32_t, Body2D> &b) { return a.first < b.first; });
+			all.clear();
+			for (auto &entry : byId) {
+				all.push_back(entry.second);
+			}
+			return true;
+		}
+
+		int Finish(int code) {
+			return mesh.Finish(code);
+		}
+
+	private:
+		Mesh mesh;
+		std::vector<Buffer> out, in;
+		std::vector<Box> boxes;
+
+		std::vector<Body2D> own;
+		std::vector<uint32_t> ids; //global id of own[i], parallel to own
+		std::vector<HaloBody> halo;
+		std::vector<Monopole> far;
+		std::vector<Monopole> poles; //every rank's monopole and extent as of the last halo, far tests use these
+		std::vector<float> extents; //so both ends of a pair of domains take the same decision
+
+		std::vector<IdPair> pairs; //every overlapping pair of the step, on every rank
+		std::vector<uint8_t> involved; //own bodies in a pair found here
+		std::vector<MergeState> states; //own bodies in any pair, then everyone's after ExchangePairs
+
+		uint64_t steps = 0;
+		uint64_t migratedHere = 0;
+		double stepSeconds = 0; //cpu time of the last step, shared with the next halo
+		std::vector<double> windowSeconds; //every rank's cpu time since the last balance check
+
+		bool Fail() {
+			status = "failed";
+			return false;
+		}
+
+		static double CpuSeconds() {
+#if defined(__linux__)
+			timespec ts;
+			clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+			return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+			return 0;
+#endif
+		}
+
+		int Owner(float x, float y) {
+			for (int p = 0; p < mesh.size; p++) {
+				if (boxes[p].Contains(x, y)) {
+					return p;
+				}
+			}
+			return mesh.rank; //NaN positions stay where they are
+		}
+
+		//every rank learns every other rank's bodies (or its monopole), its cost last step, and receives its new bodies.
+		//a body leaving this domain goes into every halo except its new owner's, so each rank sees it exactly once
+		bool ExchangeHalo() {
+			std::vector<int> dest(own.size());
+			double mass = 0, mx = 0, my = 0;
+			float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+			for (size_t counter = 0; counter < own.size(); counter++) {
+				Body2D &body = own[counter];
+				dest[counter] = Owner(body.pos.x, body.pos.y);
+				mass += body.mass;
+				mx += double(body.mass) * body.pos.x;
+				my += double(body.mass) * body.pos.y;
+				minX = std::min(minX, body.pos.x);
+				maxX = std::max(maxX, body.pos.x);
+				minY = std::min(minY, body.pos.y);
+				maxY = std::max(maxY, body.pos.y);
+			}
+			float cx = mass > 0 ? float(mx / mass) : 0, cy = mass > 0 ? float(my / mass) : 0;
+			float extent = own.empty() ? 0 : std::max(maxX - minX, maxY - minY);
+
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+				if (p == mesh.rank) {
+					continue;
+				}
+				Buffer &m = out[p];
+				m.Put(stepSeconds);
+				m.Put(Monopole{ cx, cy, float(mass) });
+				m.Put(extent);
+
+				uint32_t moving = 0;
+				for (int d : dest) {
+					moving += d == p;
+				}
+				m.Put(moving);
+				for (size_t counter = 0; counter < own.size(); counter++) {
+					if (dest[counter] == p) {
+						m.Put(ids[counter]);
+						m.Put(own[counter]);
+					}
+				}
+
+				bool isFar = Far(p);
+				m.Put(uint8_t(isFar));
+				if (!isFar) {
+					m.Put(uint32_t(own.size() - moving));
+					for (size_t counter = 0; counter < own.size(); counter++) {
+						if (dest[counter] != p) {
+							Body2D &body = own[counter];
+							m.Put(HaloBody{ ids[counter], body.pos.x, body.pos.y, body.mass, body.radius });
+						}
+					}
+				}
+			}
+
+			if (!mesh.Exchange(out, in)) {
+				return false;
+			}
+
+			//the bodies that left are gone once their new owner has them
+			size_t kept = 0;
+			for (size_t counter = 0; counter < own.size(); counter++) {
+				if (dest[counter] == mesh.rank) {
+					own[kept] = own[counter];
+					ids[kept] = ids[counter];
+					kept++;
+				}
+			}
+			migratedHere += own.size() - kept;
+			own.resize(kept);
+			ids.resize(kept);
+
+			halo.clear();
+			far.clear();
+			windowSeconds[mesh.rank] += stepSeconds;
+			poles[mesh.rank] = Monopole{ cx, cy, float(mass) };
+			extents[mesh.rank] = extent;
+			for (int p = 0; p < mesh.size; p++) {
+				if (p == mesh.rank) {
+					continue;
+				}
+				Buffer &m = in[p];
+				windowSeconds[p] += m.Get<double>();
+				Monopole pole = m.Get<Monopole>();
+				float poleExtent = m.Get<float>();
+				uint32_t moving = m.Get<uint32_t>();
+				for (uint32_t counter = 0; counter < moving; counter++) {
+					ids.push_back(m.Get<uint32_t>());
+					own.push_back(m.Get<Body2D>());
+				}
+				if (m.Get<uint8_t>()) {
+					if (pole.mass > 0) {
+						far.push_back(pole);
+					}
+				}
+				else {
+					uint32_t count = m.Get<uint32_t>();
+					for (uint32_t counter = 0; counter < count; counter++) {
+						halo.push_back(m.Get<HaloBody>());
+					}
+				}
+				poles[p] = pole;
+				extents[p] = poleExtent;
+			}
+			return true;
+		}
+
+		//whether this rank and p swap monopoles instead of bodies, symmetric so pairs are seen from both sides
+		bool Far(int p) {
+			if (theta <= 0) {
+				return false;
+			}
+			float dx = poles[p].x - poles[mesh.rank].x;
+			float dy = poles[p].y - poles[mesh.rank].y;
+			return std::max(extents[p], extents[mesh.rank]) < theta * sqrtf(dx * dx + dy * dy);
+		}
+
+		//Body2D::ComputeGravityRows over own, then the halo, then far domains. the terms are those of the serial
+		//pass, summed in a different order with more than one rank
+		bool ComputeForces() {
+			int len = own.size();
+			pairs.clear();
+			involved.assign(len, 0);
+			for (int out = 0; out < len; out++) {
+				float accX = 0, accY = 0;
+				if (own[out].active) {
+					Vec2D pos = own[out].pos;
+					float radiusOut = own[out].radius / 2;
+					for (int in = 0; in < len; in++) {
+						if (in == out || !own[in].active) {
+							continue;
+						}
+						float dx = own[in].pos.x - pos.x;
+						float dy = own[in].pos.y - pos.y;
+						float rSquared = dx * dx + dy * dy;
+						if (rSquared != 0) {
+							float gravity = Body2D::GRAVITY * (own[in].mass / rSquared);
+							float invR = 1 / sqrtf(rSquared);
+							accX += gravity * dx * invR;
+							accY -= gravity * dy * invR;
+						}
+						float minDist = (own[in].radius / 2) + radiusOut;
+						if (in > out && rSquared < minDist * minDist) {
+							pairs.push_back(IdPair{ std::min(ids[in], ids[out]), std::max(ids[in], ids[out]) });
+							involved[in] = 1;
+							involved[out] = 1;
+						}
+					}
+
+					//remote bodies are reported by both ranks, ExchangePairs drops the copy
+					for (HaloBody &h : halo) {
+						float dx = h.x - pos.x;
+						float dy = h.y - pos.y;
+						float rSquared = dx * dx + dy * dy;
+						if (rSquared != 0) {
+							float gravity = Body2D::GRAVITY * (h.mass / rSquared);
+							float invR = 1 / sqrtf(rSquared);
+							accX += gravity * dx * invR;
+							accY -= gravity * dy * invR;
+						}
+						float minDist = (h.radius / 2) + radiusOut;
+						if (rSquared < minDist * minDist) {
+							pairs.push_back(IdPair{ std::min(h.id, ids[out]), std::max(h.id, ids[out]) });
+							involved[out] = 1;
+						}
+					}
+
+					for (Monopole &pole : far) {
+						float dx = pole.x - pos.x;
+						float dy = pole.y - pos.y;
+						float rSquared = dx * dx + dy * dy;
+						if (rSquared != 0) {
+							float gravity = Body2D::GRAVITY * (pole.mass / rSquared);
+							float invR = 1 / sqrtf(rSquared);
+							accX += gravity * dx * invR;
+							accY -= gravity * dy * invR;
+						}
+					}
+				}
+				own[out].acc.x = accX;
+				own[out].acc.y = accY;
+			}
+			return true;
+		}
+
+		//every rank ends up with all pairs of the step and the current state of every body in them
+		bool ExchangePairs() {
+			states.clear();
+			for (size_t counter = 0; counter < own.size(); counter++) {
+				if (involved[counter]) {
+					Body2D &body = own[counter];
+					states.push_back(MergeState{ ids[counter], body.vel.x, body.vel.y, body.mass, body.radius });
+				}
+			}
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+				if (p == mesh.rank) {
+					continue;
+				}
+				Buffer &m = out[p];
+				m.Put(uint32_t(pairs.size()));
+				for (IdPair &pair : pairs) {
+					m.Put(pair);
+				}
+				m.Put(uint32_t(states.size()));
+				for (MergeState &s : states) {
+					m.Put(s);
+				}
+			}
+			if (!mesh.Exchange(out, in)) {
+				return false;
+			}
+			for (int p = 0; p < mesh.size; p++) {
+				if (p == mesh.rank) {
+					continue;
+				}
+				Buffer &m = in[p];
+				uint32_t count = m.Get<uint32_t>();
+				for (uint32_t counter = 0; counter < count; counter++) {
+					pairs.push_back(m.Get<IdPair>());
+				}
+				count = m.Get<uint32_t>();
+				for (uint32_t counter = 0; counter < count; counter++) {
+					states.push_back(m.Get<MergeState>());
+				}
+			}
+			std::sort(pairs.begin(), pairs.end());
+			pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+			return true;
+		}
+
+		//replays the step's merges with Body2D::ResolveCollision in id order, identically on every rank, then keeps
+		//the outcome for the bodies owned here. rows are not ids once bodies merged, so chains of merges can resolve
+		//differently from the serial pass
+		void Resolve() {
+			if (pairs.empty()) {
+				return;
+			}
+			std::unordered_map<uint32_t, int> index;
+			std::vector<Body2D> merging;
+			for (MergeState &s : states) {
+				index[s.id] = int(merging.size());
+				merging.push_back(Body2D(0, 0, s.vx, s.vy, 0, 0, s.mass, s.radius, 0));
+			}
+			for (IdPair &pair : pairs) {
+				auto hiFound = index.find(pair.hi), loFound = index.find(pair.lo);
+				if (hiFound == index.end() || loFound == index.end()) {
+					continue; //a body that moved into a far domain this step, its owner did not see the pair
+				}
+				int hi = hiFound->second, lo = loFound->second;
+				if (merging[hi].active && merging[lo].active) {
+					//Body2D::ComputeGravityRows reports {higher row, lower row}
+					Body2D::ResolveCollision(merging, hi, lo);
+				}
+			}
+
+			//swap removal, the same way Body2D::ResolveCollisions drops absorbed bodies
+			size_t counter = 0;
+			while (counter < own.size()) {
+				auto found = index.find(ids[counter]);
+				if (found != index.end()) {
+					Body2D &m = merging[found->second];
+					own[counter].vel = m.vel;
+					own[counter].mass = m.mass;
+					own[counter].radius = m.radius;
+					own[counter].active = m.active;
+					index.erase(found);
+				}
+				if (!own[counter].active) {
+					own[counter] = own.back();
+					ids[counter] = ids.back();
+					own.pop_back();
+					ids.pop_back();
+				}
+				else {
+					counter++;
+				}
+			}
+		}
+
+		//same test as HeadlessRunner::Ejected, the centre of mass from every rank's monopole
+		bool Ejected(float ejectRadius, bool &ejected) {
+			double mass = 0, mx = 0, my = 0;
+			for (Body2D &body : own) {
+				mass += body.mass;
+				mx += double(body.mass) * body.pos.x;
+				my += double(body.mass) * body.pos.y;
+			}
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+				out[p].Put(mass);
+				out[p].Put(mx);
+				out[p].Put(my);
+			}
+			if (!mesh.Exchange(out, in)) {
+				return false;
+			}
+			for (int p = 0; p < mesh.size; p++) {
+				if (p != mesh.rank) {
+					mass += in[p].Get<double>();
+					mx += in[p].Get<double>();
+					my += in[p].Get<double>();
+				}
+			}
+
+			uint8_t here = 0;
+			if (mass > 0) {
+				double cx = mx / mass, cy = my / mass;
+				for (Body2D &body : own) {
+					double dx = body.pos.x - cx, dy = body.pos.y - cy;
+					if (dx * dx + dy * dy > double(ejectRadius) * ejectRadius) {
+						here = 1;
+						break;
+					}
+				}
+			}
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+				out[p].Put(here);
+			}
+			if (!mesh.Exchange(out, in)) {
+				return false;
+			}
+			ejected = here != 0;
+			for (int p = 0; p < mesh.size; p++) {
+				if (p != mesh.rank && in[p].Get<uint8_t>()) {
+					ejected = true;
+				}
+			}
+			return true;
+		}
+
+		//cuts new boxes when the slowest rank is too far above the mean. every rank holds the same windowSeconds,
+		//so all of them take the same decision, and all bodies are gathered in rank order so they cut the same boxes
+		bool CheckBalance() {
+			double total = 0, slowest = 0;
+			for (double s : windowSeconds) {
+				total += s;
+				slowest = std::max(slowest, s);
+			}
+			double mean = total / mesh.size;
+			bool balanced = mean <= 0 || slowest <= mean * (1 + rebalanceTolerance);
+			double cost = windowSeconds[mesh.rank];
+			std::fill(windowSeconds.begin(), windowSeconds.end(), 0);
+			if (balanced) {
+				return true;
+			}
+
+			//a body's weight is its rank's average cost per body over the window
+			float weight = own.empty() ? 0 : float(cost / own.size());
+			for (int p = 0; p < mesh.size; p++) {
+				out[p].Clear();
+				if (p == mesh.rank) {
+					continue;
+				}
+				out[p].Put(uint32_t(own.size()));
+				for (Body2D &body : own) {
+					out[p].Put(WeightedPoint{ body.pos.x, body.pos.y, weight });
+				}
+			}
+			if (!mesh.Exchange(out, in)) {
+				return false;
+			}
+
+			std::vector<WeightedPoint> points;
+			for (int p = 0; p < mesh.size; p++) {
+				if (p == mesh.rank) {
+					for (Body2D &body : own) {
+						points.push_back(WeightedPoint{ body.pos.x, body.pos.y, weight });
+					}
+					continue;
+				}
+				uint32_t count = in[p].Get<uint32_t>();
+				for (uint32_t counter = 0; counter < count; counter++) {
+					points.push_back(in[p].Get<WeightedPoint>());
+				}
+			}
+			boxes = Bisect(points, mesh.size);
+			rebalances++;
+			return true;
+		}
+	};
+}
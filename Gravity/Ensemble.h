@@ -0,0 +1,337 @@
+#pragma once
+#include "Physics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//Many small independent systems with the same body count, stepped together.
+//Arrays are body major, element [body * systems + system], so every inner loop runs across systems:
+//the compiler maps systems onto SIMD lanes and threads take contiguous ranges of systems.
+//Systems never interact, so each thread runs its whole range to the end without synchronising.
+//
+//The force and merge rules are the ones in Body2D::ComputeGravityRows and Body2D::ResolveCollision,
+//unperturbed systems step exactly like a Body2D run. Merged bodies stay in place as inactive slots
+//instead of being swap removed, so after a merge the summation order differs from a Body2D run.
+class Ensemble {
+public:
+	enum Status { RUNNING, COLLIDED, EJECTED, FINISHED };
+
+	int systems = 0, bodies = 0;
+	std::vector<float> x, y, vx, vy, ax, ay, mass;
+	std::vector<int> radius;
+	std::vector<uint8_t> active;
+
+	//per system
+	std::vector<uint8_t> status;
+	std::vector<uint64_t> steps;
+	std::vector<int> merges;
+	std::vector<double> startEnergy;
+
+	bool stopOnCollision = true; //otherwise bodies merge and the system keeps running
+	float ejectRadius = 0; //a body this far from the system's centre of mass ends it, 0 disables
+
+	//copies of base with every mass and velocity scaled by a uniform factor in [1 - spread, 1 + spread].
+	//system s uses its own random stream, so a system is reproducible from the seed and its index alone
+	void Init(const std::vector<Body2D> &base, int systemCount, float massSpread, float velSpread, unsigned int seed = 1) {
+		systems = systemCount;
+		bodies = int(base.size());
+		size_t n = size_t(systems) * bodies;
+		x.assign(n, 0); y.assign(n, 0);
+		vx.assign(n, 0); vy.assign(n, 0);
+		ax.assign(n, 0); ay.assign(n, 0);
+		mass.assign(n, 0);
+		radius.assign(n, 0);
+		active.assign(n, 0);
+		status.assign(systems, RUNNING);
+		steps.assign(systems, 0);
+		merges.assign(systems, 0);
+		startEnergy.assign(systems, 0);
+
+		for (int s = 0; s < systems; s++) {
+			uint32_t state = (seed * 2654435761u) ^ (uint32_t(s) * 40503u + 1);
+			auto random = [&state]() {
+				//xorshift32, same generator as Body2D::InitRandomBodies
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				return (state & 0xFFFFFF) / float(0x1000000);
+			};
+			for (int k = 0; k < bodies; k++) {
+				size_t i = Index(k, s);
+				float massScale = (massSpread > 0) ? 1 + massSpread * (2 * random() - 1) : 1;
+				float velScale = (velSpread > 0) ? 1 + velSpread * (2 * random() - 1) : 1;
+				x[i] = base[k].pos.x;
+				y[i] = base[k].pos.y;
+				vx[i] = base[k].vel.x * velScale;
+				vy[i] = base[k].vel.y * velScale;
+				mass[i] = base[k].mass * massScale;
+				radius[i] = base[k].radius;
+				active[i] = base[k].active;
+			}
+			startEnergy[s] = Energy(s);
+		}
+	}
+
+	size_t Index(int body, int system) const {
+		return size_t(body) * systems + system;
+	}
+
+	//steps every system until it stops or has taken maxSteps, returns the total system steps taken
+	uint64_t Run(uint64_t maxSteps, float dt, bool leapfrog = false, int threads = 1) {
+		threads = std::max(1, std::min(threads, (systems + SLICE_ALIGN - 1) / SLICE_ALIGN));
+		if (threads <= 1) {
+			RunSlice(0, systems, maxSteps, dt, leapfrog);
+		}
+		else {
+			//slices are multiples of SLICE_ALIGN systems, a cache line of the byte wide columns and more of the wider
+			//ones. rows and vectors are not line aligned, so neighbouring threads can still share the line at each
+			//end of a slice in every row, but never more than that
+			std::vector<std::thread> workers;
+			int perThread = (systems + threads - 1) / threads;
+			perThread = (perThread + SLICE_ALIGN - 1) / SLICE_ALIGN * SLICE_ALIGN;
+			for (int begin = 0; begin < systems; begin += perThread) {
+				workers.push_back(std::thread(&Ensemble::RunSlice, this, begin, std::min(systems, begin + perThread), maxSteps, dt, leapfrog));
+			}
+			for (std::thread &t : workers) {
+				t.join();
+			}
+		}
+
+		uint64_t total = 0;
+		for (int s = 0; s < systems; s++) {
+			total += steps[s];
+		}
+		return total;
+	}
+
+	//same sum as Body2D::TotalEnergy
+	double Energy(int s) const {
+		double energy = 0;
+		for (int out = 0; out < bodies; out++) {
+			size_t o = Index(out, s);
+			if (!active[o]) {
+				continue;
+			}
+			energy += 0.5 * mass[o] * (vx[o] * vx[o] + vy[o] * vy[o]);
+			for (int in = out + 1; in < bodies; in++) {
+				size_t i = Index(in, s);
+				float r = sqrtf((x[i] - x[o]) * (x[i] - x[o]) + (y[i] - y[o]) * (y[i] - y[o]));
+				if (active[i] && r > 0) {
+					energy -= double(Body2D::GRAVITY) * mass[o] * mass[i] / r;
+				}
+			}
+		}
+		return energy;
+	}
+
+	static const char* StatusName(int status) {
+		const char* names[] = { "running", "collided", "ejected", "finished" };
+		return names[status];
+	}
+
+private:
+	static const int SLICE_ALIGN = 64; //systems, one cache line of active and status
+
+	void RunSlice(int begin, int end, uint64_t maxSteps, float dt, bool leapfrog) {
+		std::vector<uint8_t> hit(systems, 0);
+
+		//leapfrog needs the accelerations of the starting positions, like the headless runner does
+		if (leapfrog) {
+			ComputeGravity(begin, end, hit.data());
+			ResolveCollisions(begin, end, hit);
+		}
+
+		for (uint64_t step = 0; step < maxSteps; step++) {
+			//stopped systems at either end of the slice are dropped, the ones in between stay masked
+			while (begin < end && status[begin] != RUNNING) {
+				begin++;
+			}
+			while (end > begin && status[end - 1] != RUNNING) {
+				end--;
+			}
+			if (begin == end) {
+				break;
+			}
+			for (int s = begin; s < end; s++) {
+				steps[s] += (status[s] == RUNNING);
+			}
+
+			if (leapfrog) {
+				Kick(begin, end, dt / 2);
+				Drift(begin, end, dt);
+				ComputeGravity(begin, end, hit.data());
+				Kick(begin, end, dt / 2);
+				ResolveCollisions(begin, end, hit);
+			}
+			else {
+				//same order as Body2D::UpdateGravity then Body2D::UpdateVelandPos
+				ComputeGravity(begin, end, hit.data());
+				ResolveCollisions(begin, end, hit);
+				Kick(begin, end, dt);
+				Drift(begin, end, dt);
+			}
+
+			for (int s = begin; s < end; s++) {
+				if (status[s] != RUNNING) {
+					continue;
+				}
+				if (ejectRadius > 0 && Ejected(s)) {
+					status[s] = EJECTED;
+				}
+				else if (steps[s] >= maxSteps) {
+					status[s] = FINISHED;
+				}
+			}
+		}
+	}
+
+	//accelerations for every system in [begin, end), hit[s] is set when two of its bodies overlap
+	void ComputeGravity(int begin, int end, uint8_t* hit) {
+		for (int s = begin; s < end; s++) {
+			hit[s] = 0;
+		}
+		for (int out = 0; out < bodies; out++) {
+			size_t o = Index(out, 0);
+			for (int s = begin; s < end; s++) {
+				ax[o + s] = 0;
+				ay[o + s] = 0;
+			}
+			for (int in = 0; in < bodies; in++) {
+				if (in != out) {
+					size_t i = Index(in, 0);
+					AccumulatePair(begin, end, &x[o], &y[o], &radius[o], &active[o], &x[i], &y[i], &mass[i], &radius[i], &active[i],
+						&ax[o], &ay[o], hit, in > out);
+				}
+			}
+		}
+	}
+
+	//pull of body row i on body row o across systems. the rows are __restrict parameters (restrict on locals is
+	//ignored) and the body has selects only, so with -O3 -fno-math-errno this loop vectorises
+	static void AccumulatePair(int begin, int end, const float* __restrict xo, const float* __restrict yo, const int* __restrict ro,
+		const uint8_t* __restrict ao, const float* __restrict xi, const float* __restrict yi, const float* __restrict mi,
+		const int* __restrict ri, const uint8_t* __restrict ai, float* __restrict axo, float* __restrict ayo,
+		uint8_t* __restrict hit, uint8_t reportPairs) {
+		for (int s = begin; s < end; s++) {
+			float dx = xi[s] - xo[s];
+			float dy = yi[s] - yo[s];
+			float rSquared = dx * dx + dy * dy;
+			uint8_t both = ao[s] & ai[s];
+
+			//a skipped pair adds 0 times a finite value, so the sums match Body2D::ComputeGravityRows exactly.
+			//rSquared + 0 is rSquared, the 1 only keeps coincident bodies from producing inf * 0
+			float use = (both && rSquared != 0) ? 1.0f : 0.0f;
+			float safeR = rSquared + (rSquared == 0 ? 1.0f : 0.0f);
+			float gravity = Body2D::GRAVITY * (mi[s] / safeR);
+			float invR = 1 / sqrtf(safeR);
+			axo[s] += use * (gravity * dx * invR);
+			ayo[s] -= use * (gravity * dy * invR);
+
+			//each pair is reported once, by its lower row
+			float minDist = float((ri[s] / 2) + (ro[s] / 2));
+			hit[s] |= reportPairs & both & uint8_t(rSquared < minDist * minDist);
+		}
+	}
+
+	//merges overlapping pairs of the systems that were hit, in the order Body2D::ComputeGravity reports them.
+	//with stopOnCollision nothing is merged, the system stops in the state it collided in
+	void ResolveCollisions(int begin, int end, std::vector<uint8_t> &hit) {
+		for (int s = begin; s < end; s++) {
+			if (!hit[s] || status[s] != RUNNING) {
+				continue;
+			}
+			if (stopOnCollision) {
+				status[s] = COLLIDED;
+				continue;
+			}
+
+			//find the pairs again from the positions, the vectorised pass only keeps one flag per system
+			std::vector<std::pair<int, int>> pairs;
+			for (int out = 0; out < bodies; out++) {
+				size_t o = Index(out, s);
+				for (int in = out + 1; in < bodies; in++) {
+					size_t i = Index(in, s);
+					float dx = x[i] - x[o];
+					float dy = y[i] - y[o];
+					float minDist = (radius[i] / 2) + (radius[o] / 2);
+					if (active[o] && active[i] && dx * dx + dy * dy < minDist * minDist) {
+						pairs.push_back(std::make_pair(in, out));
+					}
+				}
+			}
+			for (auto &pair : pairs) {
+				size_t i1 = Index(pair.first, s);
+				size_t i2 = Index(pair.second, s);
+				if (active[i1] && active[i2]) {
+					Merge(i1, i2);
+					merges[s]++;
+				}
+			}
+		}
+	}
+
+	//Body2D::ResolveCollision on two slots
+	void Merge(size_t i1, size_t i2) {
+		size_t index = (mass[i1] > mass[i2]) ? i1 : i2;
+		size_t absorbed = (index == i1) ? i2 : i1;
+
+		vx[index] = ((mass[i1] * vx[i1]) + (mass[i2] * vx[i2])) / (mass[i1] + mass[i2]);
+		vy[index] = ((mass[i1] * vy[i1]) + (mass[i2] * vy[i2])) / (mass[i1] + mass[i2]);
+		radius[index] = int(sqrt((radius[index] * radius[index]) + (radius[absorbed] * radius[absorbed])));
+		mass[index] += mass[absorbed];
+		active[absorbed] = 0;
+	}
+
+	void Kick(int begin, int end, float dt) {
+		for (int k = 0; k < bodies; k++) {
+			size_t row = Index(k, 0);
+			AddScaled(begin, end, &vx[row], &ax[row], &active[row], status.data(), dt);
+			AddScaled(begin, end, &vy[row], &ay[row], &active[row], status.data(), dt);
+		}
+	}
+
+	//pos.y points down the screen while vel.y points up, see Body2D::UpdatePos
+	void Drift(int begin, int end, float dt) {
+		for (int k = 0; k < bodies; k++) {
+			size_t row = Index(k, 0);
+			AddScaled(begin, end, &x[row], &vx[row], &active[row], status.data(), dt);
+			AddScaled(begin, end, &y[row], &vy[row], &active[row], status.data(), -dt);
+		}
+	}
+
+	//to[s] += from[s] * dt for the active bodies of running systems
+	static void AddScaled(int begin, int end, float* __restrict to, const float* __restrict from, const uint8_t* __restrict active,
+		const uint8_t* __restrict status, float dt) {
+		for (int s = begin; s < end; s++) {
+			float move = (active[s] & (status[s] == RUNNING)) ? dt : 0.0f;
+			to[s] += from[s] * move;
+		}
+	}
+
+	bool Ejected(int s) {
+		double m = 0, cx = 0, cy = 0;
+		for (int k = 0; k < bodies; k++) {
+			size_t i = Index(k, s);
+			if (active[i]) {
+				m += mass[i];
+				cx += double(mass[i]) * x[i];
+				cy += double(mass[i]) * y[i];
+			}
+		}
+		if (m <= 0) {
+			return false;
+		}
+		cx /= m;
+		cy /= m;
+		for (int k = 0; k < bodies; k++) {
+			size_t i = Index(k, s);
+			double dx = x[i] - cx, dy = y[i] - cy;
+			if (active[i] && dx * dx + dy * dy > double(ejectRadius) * ejectRadius) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
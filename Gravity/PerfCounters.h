@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//Hardware counters for the calling thread through perf_event_open, Linux only.
+//Everywhere else, or when the kernel refuses (perf_event_paranoid, containers), Open() returns false
+//and Read() returns zeros, so callers never need their own #ifdefs.
+//Only user space is counted, which works with the default perf_event_paranoid of 2.
+//The counters are inherited, so the worker threads Body2D::ComputeGravity starts and joins inside a
+//scope are included. Inheriting rules out PERF_FORMAT_GROUP, so each counter is read on its own.
+
+struct CounterValues {
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	uint64_t cacheMisses = 0;
+	uint64_t branchMisses = 0;
+
+	CounterValues operator-(const CounterValues &o) const {
+		CounterValues d;
+		d.cycles = cycles - o.cycles;
+		d.instructions = instructions - o.instructions;
+		d.cacheMisses = cacheMisses - o.cacheMisses;
+		d.branchMisses = branchMisses - o.branchMisses;
+		return d;
+	}
+
+	CounterValues& operator+=(const CounterValues &o) {
+		cycles += o.cycles;
+		instructions += o.instructions;
+		cacheMisses += o.cacheMisses;
+		branchMisses += o.branchMisses;
+		return *this;
+	}
+
+	double Ipc() const {
+		return cycles > 0 ? double(instructions) / cycles : 0;
+	}
+};
+
+class PerfCounters {
+public:
+	static const int COUNTERS = 4;
+
+	PerfCounters() = default;
+	PerfCounters(const PerfCounters&) = delete; //owns the descriptors
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	~PerfCounters() {
+		Close();
+	}
+
+	//opens the four counters as one group so they are always scheduled on the pmu together
+	bool Open() {
+		Close();
+#if defined(__linux__)
+		const uint64_t configs[COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+		for (int i = 0; i < COUNTERS; i++) {
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = configs[i];
+			attr.disabled = (i == 0);
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.inherit = 1;
+
+			//this thread, any cpu
+			fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+			if (fds[i] < 0) {
+				Close();
+				return false;
+			}
+		}
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		open = true;
+#endif
+		return open;
+	}
+
+	void Close() {
+#if defined(__linux__)
+		for (int i = 0; i < COUNTERS; i++) {
+			if (fds[i] >= 0) {
+				close(fds[i]);
+				fds[i] = -1;
+			}
+		}
+#endif
+		open = false;
+	}
+
+	bool IsOpen() {
+		return open;
+	}
+
+	//running totals since Open()
+	CounterValues Read() {
+		CounterValues v;
+#if defined(__linux__)
+		if (open) {
+			uint64_t values[COUNTERS] = { 0, 0, 0, 0 };
+			for (int i = 0; i < COUNTERS; i++) {
+				if (read(fds[i], &values[i], sizeof(uint64_t)) != ssize_t(sizeof(uint64_t))) {
+					values[i] = 0;
+				}
+			}
+			v.cycles = values[0];
+			v.instructions = values[1];
+			v.cacheMisses = values[2];
+			v.branchMisses = values[3];
+		}
+#endif
+		return v;
+	}
+
+private:
+	int fds[COUNTERS] = { -1, -1, -1, -1 };
+	bool open = false;
+};
@@ -0,0 +1,481 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//Simulation types shared by the viewer and the headless tools.
+//Nothing in here may depend on olcPixelGameEngine, the headless runner must build without a window or OpenGL.
+
+//packed RGBA colours, same layout as olc::Pixel::n so the viewer can draw them directly
+namespace BodyColor {
+	const uint32_t GREY = 0xFFC0C0C0;
+	const uint32_t YELLOW = 0xFF00FFFF;
+	const uint32_t GREEN = 0xFF00FF00;
+	const uint32_t BLUE = 0xFFFF0000;
+}
+
+class Vec2D {
+public:
+	float x, y;
+
+	Vec2D(float xPos = 0.0f, float yPos = 0.0f) {
+		x = xPos;
+		y = yPos;
+	}
+
+	//returns the magnitude of the vector compared to 0, 0
+	float mag() {
+		return sqrtf(x*x + y*y);
+	}
+
+	//returns distance between this vector and vector passed in.
+	float dist(Vec2D v2) {
+		return sqrtf(VectorDistanceSquared(*this, v2));
+	}
+
+	//angle in radians, use sinAngleBetween, cosAngleBetween, for more efficiency (I think).
+	float angleBetween(Vec2D v2) {
+		return atan2f((v2.x - this->x), (v2.y - this->y));
+	}
+
+	float sinAngleBetween(Vec2D v2) {
+		//opposite over hypoteneuse
+		return -1*((v2.y - this->y) / sqrtf(VectorDistanceSquared(*this, v2)));
+	}
+
+	float cosAngleBetween(Vec2D v2) {
+		//adjacent over hypoteneuse
+		return ((v2.x - this->x) / sqrtf(VectorDistanceSquared(*this, v2)));
+	}
+
+	float tanAngleBetween(Vec2D v2) {
+		return (this->sinAngleBetween(v2) / this->cosAngleBetween(v2));
+	}
+
+	void normalize() {
+
+		float mag = this->mag();
+
+		this->x /= mag;
+		this->y /= mag;
+	}
+
+	//multiplies vector by a scalar
+	void scale(float sFactor) {
+		this->x *= sFactor;
+		this->y *= sFactor;
+	}
+
+	//returns square of magnitude of the vector
+	float magSquared() {
+		return ((this->x * this->x) + (this->y * this->y));
+	}
+
+	//clamps magnitude of vec between min and max
+	void clamp(float min, float max) {
+		if (this->magSquared() < (min*min)) {
+			this->normalize();
+			this->scale(min);
+		}
+		else if (this->magSquared() > (max*max)) {
+			this->normalize();
+			this->scale(max);
+		}
+			
+	}
+
+	//Static functions
+	//adds two vectors using vector addition
+	static Vec2D VectorAdd(Vec2D v1, Vec2D v2) {
+		return Vec2D(v1.x + v2.x, v1.y + v2.y);
+	}
+
+	//returns distance between two vectors squared
+	static float VectorDistanceSquared(Vec2D v1, Vec2D v2) {
+		return ((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y));
+	}
+};
+
+//two bodies close enough to merge, found during the gravity pass
+struct CollisionPair {
+	int a, b;
+};
+
+class Body2D {
+public:
+
+	static const int METERS_TO_PIXELS = 500000000; //number of square meters per pixel
+	static const int STAR_ENLARGEMENT_FACTOR = 10; //multiply star radius by this number to make star visible
+	static const int PLANET_ENLARGEMENT_FACTOR = 20; // same as above but for planets
+	static constexpr float GRAVITY = 100000; //gravitational constant in simulation units
+	static const int MIN_BODIES_PER_THREAD = 256; //below this starting threads costs more than it saves
+	static const int COST_BLOCK = 64; //rows timed together when measuring cost
+
+	//static const int numBodies = 9;
+	
+
+	//Vector velocity
+	//acceleration
+	//position
+	//radius
+	//light source?
+	bool active;
+	int mass, radius;
+	Vec2D pos, vel, acc;
+	uint32_t color;
+
+	Vec2D velDrawArrowEnd;
+
+	float cost = 1; //ns spent on this body's row in the last threaded gravity pass
+
+	bool toggleAsCenter = false;
+
+	Body2D(float xPos, float yPos, float xVel, float yVel, float xAcc, float yAcc, int m, int r, uint32_t colorPixel) {
+		pos = Vec2D(xPos, yPos);
+		vel = Vec2D(xVel, yVel);
+		acc = Vec2D(xAcc, yAcc);
+		mass = m;
+		radius = r;
+		active = true;
+		color = colorPixel;
+	}
+
+	Body2D() = default;
+
+	void UpdateVel(float fElapsedTime) {
+		if (this->active) {
+			this->vel.x += (this->acc.x * fElapsedTime);
+			this->vel.y += (this->acc.y * fElapsedTime);
+		}
+	}
+
+	void UpdatePos(float fElapsedTime) {
+		if (this->active) {
+			this->pos.x += (this->vel.x * fElapsedTime);
+			this->pos.y -= (this->vel.y * fElapsedTime);
+		}
+	}
+
+
+	//STATIC FUNCTIONS
+
+	static void UpdateVelandPos(std::vector<Body2D> &b, float fElapsedTime) {
+		int len = b.size();
+
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].UpdateVel(fElapsedTime);
+			b[counter].UpdatePos(fElapsedTime);
+		}
+	}
+
+	//kick-drift-kick leapfrog, second order and time reversible unlike UpdateVelandPos.
+	//acc must already hold the accelerations for the current positions, the caller resolves the returned pairs
+	static void UpdateLeapfrog(std::vector<Body2D> &b, float fElapsedTime, std::vector<CollisionPair> &pairs, int threads = 1) {
+		int len = b.size();
+
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].UpdateVel(fElapsedTime / 2);
+			b[counter].UpdatePos(fElapsedTime);
+		}
+
+		ComputeGravity(b, pairs, threads);
+
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].UpdateVel(fElapsedTime / 2);
+		}
+	}
+
+	static void InitBodies(std::vector<Body2D> &b) {
+		//sun, earth, moon
+		b.push_back(Body2D(750, 400, 0, 150, 0, 0, 1, 9, BodyColor::BLUE));
+		b.push_back(Body2D(400, 400, 0, 0, 0, 0, 100, 35, BodyColor::YELLOW));
+		b.push_back(Body2D(790, 400, 0, 100, 0, 0, .01, 3, BodyColor::GREY));
+		
+		/*
+		b.push_back(Body2D(750 + 1000, 400, 0, 150, 0, 0, 1, 9, BodyColor::BLUE));
+		b.push_back(Body2D(400 + 1000, 400, 0, 0, 0, 0, 100, 35, BodyColor::YELLOW));
+		b.push_back(Body2D(790 + 1000, 400, 0, 100, 0, 0, .01, 3, BodyColor::GREY));
+
+		b.push_back(Body2D(750 - 1000, 400, 0, 150, 0, 0, 1, 9, BodyColor::BLUE));
+		b.push_back(Body2D(400 - 1000, 400, 0, 0, 0, 0, 100, 35, BodyColor::YELLOW));
+		b.push_back(Body2D(790 - 1000, 400, 0, 100, 0, 0, .01, 3, BodyColor::GREY));
+
+		*/
+
+		/*
+		//collision
+		b[0] = Body2D(600, 600, -160, 200, 0, 0, 1, 30, olc::BLUE);
+		b[1] = Body2D(400, 400, 50, 0, 0, 0, 10, 30, olc::YELLOW);
+		*/
+
+		//b[0] = Body2D(100, 120, 200, 0, 0, 0, 10, 10, olc::DARK_RED);
+		//b[1] = Body2D(400, 400, 0, 0, 0, 0, 100, 10, olc::GREEN);
+		//b[3] = Body2D(400, 1800, 100, 100, 0, 0, 3, 15, olc::YELLOW);
+	}
+
+	//bodies in a disk on roughly circular orbits around a heavy star at the origin, for large runs.
+	//same seed gives the same scenario on every machine
+	static void InitRandomBodies(std::vector<Body2D> &b, int count, unsigned int seed = 1) {
+		b.push_back(Body2D(0, 0, 0, 0, 0, 0, 1000, 60, BodyColor::YELLOW));
+
+		uint32_t state = seed ? seed : 1;
+		auto random = [&state]() {
+			//xorshift32, std distributions differ between standard libraries
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (state & 0xFFFFFF) / float(0x1000000);
+		};
+
+		float innerRadius = 200;
+		float outerRadius = 200 + 20 * sqrtf((float)count);
+		for (int counter = 1; counter < count; counter++) {
+			float r = innerRadius + (outerRadius - innerRadius) * sqrtf(random());
+			float angle = 2 * 3.14159265f * random();
+			float cosA = cosf(angle);
+			float sinA = sinf(angle);
+
+			//pos.y points down the screen while vel.y points up, see UpdatePos
+			float speed = sqrtf(GRAVITY * b[0].mass / r);
+			b.push_back(Body2D(r * cosA, r * sinA, -speed * sinA, -speed * cosA, 0, 0, 1, 4, random() < 0.5f ? BodyColor::GREY : BodyColor::BLUE));
+		}
+	}
+
+	//kinetic and potential energy of the active bodies, O(n^2)
+	static double TotalEnergy(std::vector<Body2D> &b) {
+		double energy = 0;
+		int len = b.size();
+		for (int out = 0; out < len; out++) {
+			if (!b[out].active) {
+				continue;
+			}
+			energy += 0.5 * b[out].mass * b[out].vel.magSquared();
+			for (int in = out + 1; in < len; in++) {
+				float r = b[out].pos.dist(b[in].pos);
+				if (b[in].active && r > 0) {
+					energy -= double(GRAVITY) * b[out].mass * b[in].mass / r;
+				}
+			}
+		}
+		return energy;
+	}
+
+	//angular momentum about the origin, y is flipped between pos and vel
+	static double AngularMomentum(std::vector<Body2D> &b) {
+		double l = 0;
+		int len = b.size();
+		for (int counter = 0; counter < len; counter++) {
+			if (b[counter].active) {
+				l += double(b[counter].mass) * (b[counter].pos.x * b[counter].vel.y + b[counter].pos.y * b[counter].vel.x);
+			}
+		}
+		return l;
+	}
+
+	//Updates gravity on all the objects, and resolves collisions
+	static void UpdateGravity(std::vector<Body2D> &b, int threads = 1, std::vector<int>* removed = nullptr) {
+		std::vector<CollisionPair> pairs;
+		ComputeGravity(b, pairs, threads);
+		ResolveCollisions(b, pairs, removed);
+	}
+
+	//sets acc on every body and collects the overlapping pairs, bodies are not changed otherwise.
+	//rows are split over threads in contiguous zones of equal cost as measured in the previous threaded pass,
+	//each thread only writes the acc and cost of its own rows. pairs come out in row order for any thread count
+	static void ComputeGravity(std::vector<Body2D> &b, std::vector<CollisionPair> &pairs, int threads = 1) {
+		int len = b.size();
+		threads = GravityThreads(len, threads);
+		if (threads <= 1) {
+			ComputeGravityRows(b, 0, len, pairs);
+			return;
+		}
+
+		std::vector<int> zones = CostZones(b, threads);
+		std::vector<std::vector<CollisionPair>> threadPairs(threads);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.push_back(std::thread(ComputeGravityTimed, std::ref(b), zones[t], zones[t + 1], std::ref(threadPairs[t])));
+		}
+		for (int t = 0; t < threads; t++) {
+			workers[t].join();
+			pairs.insert(pairs.end(), threadPairs[t].begin(), threadPairs[t].end());
+		}
+	}
+
+	//threads ComputeGravity really starts for len bodies when asked for threads, at least 1
+	static int GravityThreads(int len, int threads) {
+		return std::max(1, std::min(threads, len / MIN_BODIES_PER_THREAD));
+	}
+
+	//threads + 1 row boundaries so every zone holds the same share of the summed cost.
+	//clustered scenes spend more per row in the dense parts (overlap tests taken, pairs pushed), an equal count split leaves threads idle
+	static std::vector<int> CostZones(std::vector<Body2D> &b, int threads) {
+		int len = b.size();
+		double total = 0;
+		for (int counter = 0; counter < len; counter++) {
+			total += b[counter].cost;
+		}
+
+		std::vector<int> zones(threads + 1, len);
+		zones[0] = 0;
+		int row = 0;
+		double sum = 0;
+		for (int t = 1; t < threads; t++) {
+			if (!(total > 0)) {
+				zones[t] = int((long long)len * t / threads);
+				continue;
+			}
+			double target = total * t / threads;
+			while (row < len && sum + b[row].cost <= target) {
+				sum += b[row].cost;
+				row++;
+			}
+			zones[t] = row;
+		}
+		return zones;
+	}
+
+	//ComputeGravityRows in blocks of COST_BLOCK rows, each row's cost is its block's time shared out evenly
+	static void ComputeGravityTimed(std::vector<Body2D> &b, int begin, int end, std::vector<CollisionPair> &pairs) {
+		for (int block = begin; block < end; block += COST_BLOCK) {
+			int blockEnd = block + COST_BLOCK < end ? block + COST_BLOCK : end;
+			auto start = std::chrono::steady_clock::now();
+			ComputeGravityRows(b, block, blockEnd, pairs);
+			float ns = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count();
+			for (int counter = block; counter < blockEnd; counter++) {
+				b[counter].cost = ns / (blockEnd - block);
+			}
+		}
+	}
+
+	//direct summation for rows [begin, end)
+	static void ComputeGravityRows(std::vector<Body2D> &b, int begin, int end, std::vector<CollisionPair> &pairs) {
+		int len = b.size();
+		for (int out = begin; out < end; out++) {
+			float accX = 0, accY = 0;
+			if (b[out].active) {
+				Vec2D pos = b[out].pos;
+				float radiusOut = b[out].radius / 2;
+				for (int in = 0; in < len; in++) {
+					if (in == out || !b[in].active) {
+						continue;
+					}
+					float dx = b[in].pos.x - pos.x;
+					float dy = b[in].pos.y - pos.y;
+					float rSquared = dx * dx + dy * dy;
+
+					//same as cosAngleBetween and sinAngleBetween but with one sqrt
+					if (rSquared != 0) {
+						float gravity = GRAVITY * (b[in].mass / rSquared);
+						float invR = 1 / sqrtf(rSquared);
+						accX += gravity * dx * invR;
+						accY -= gravity * dy * invR;
+					}
+
+					//each pair is reported once, by its lower row
+					float minDist = (b[in].radius / 2) + radiusOut;
+					if (in > out && rSquared < minDist * minDist) {
+						pairs.push_back(CollisionPair{ in, out });
+					}
+				}
+			}
+			b[out].acc.x = accX;
+			b[out].acc.y = accY;
+		}
+	}
+
+	//merges the overlapping pairs in order and removes the absorbed bodies. every removal moves the last body into the
+	//removed row, removed gets those rows in order so per body data kept elsewhere can follow
+	static void ResolveCollisions(std::vector<Body2D> &b, std::vector<CollisionPair> &pairs, std::vector<int>* removed = nullptr) {
+		for (CollisionPair &pair : pairs) {
+			if (b[pair.a].active && b[pair.b].active) {
+				ResolveCollision(b, pair.a, pair.b);
+			}
+		}
+		if (pairs.empty()) {
+			return;
+		}
+
+		int counter = 0;
+		while (counter < (int)b.size()) {
+			if (!b[counter].active) {
+				b[counter] = b[b.size() - 1];
+				b.resize(b.size() - 1);
+				if (removed != nullptr) {
+					removed->push_back(counter);
+				}
+			}
+			else {
+				counter++;
+			}
+		}
+	}
+
+	static void ResolveCollision(std::vector<Body2D> &b,int i1, int i2) {
+		int index = 0;
+		int toBeDeactivated = 0;
+		if (b[i1].mass > b[i2].mass) {
+			toBeDeactivated = i2;
+			index = i1;
+		}
+		else {
+			toBeDeactivated = i1;
+			index = i2;
+		}
+
+		//set velocties to conserve momentum
+		b[index].vel.x = ((b[i1].mass * b[i1].vel.x) + (b[i2].mass * b[i2].vel.x)) / (b[i1].mass + b[i2].mass);
+		b[index].vel.y = ((b[i1].mass * b[i1].vel.y) + (b[i2].mass * b[i2].vel.y)) / (b[i1].mass + b[i2].mass);
+		
+
+		//set radius of new planet/star
+		b[index].radius = sqrt((b[index].radius * b[index].radius) + (b[toBeDeactivated].radius * b[toBeDeactivated].radius));
+
+		//set mass to sum and deactivate other planet.
+		b[index].mass += b[toBeDeactivated].mass;
+		b[toBeDeactivated].active = false;
+	}
+
+	static void AddBodyAt(std::vector<Body2D> &b, Vec2D pos) {
+		b.push_back(Body2D(pos.x, pos.y, 0, 0, 0, 0, 1, 10, BodyColor::GREEN));
+		//UpdateGravity(b);
+	}
+
+	static void DeleteBodyAt(std::vector<Body2D> &b, Vec2D mousePos, std::vector<int>* removed = nullptr) {
+		for (int counter = 0; counter < b.size(); counter++) {
+			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
+				b[counter].active = false;
+
+				Body2D temp = b[b.size() - 1];
+				b[b.size() - 1] = b[counter];
+				b[counter] = temp;
+				b.resize(b.size() - 1);
+				if (removed != nullptr) {
+					removed->push_back(counter); //same as ResolveCollisions, the last body now sits in this row
+				}
+			}
+		}
+	}
+
+	static void AddMassAt(std::vector<Body2D> &b, Vec2D mousePos) {
+		for (int counter = 0; counter < b.size(); counter++) {
+			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
+				b[counter].mass += 10;
+			}
+		}
+	}
+
+	static void ToggleCenterPlanet(std::vector<Body2D> &b, Vec2D mousePos) {
+		for (int counter = 0; counter < b.size(); counter++) {
+			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
+				b[counter].toggleAsCenter = !b[counter].toggleAsCenter;
+			}
+			else {
+				b[counter].toggleAsCenter = false;
+			}
+		}
+	}
+};
@@ -0,0 +1,299 @@
+#pragma once
+#include "AllocTracker.h"
+#include "PerfCounters.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//Per phase frame timing. Phases are registered once by name, then timed every frame with a Scope.
+//The last HISTORY_FRAMES frames are kept for the overlay graph, and while a capture is running
+//every scope is also stored as a Chrome trace event (load the file in chrome://tracing or ui.perfetto.dev).
+//With EnableCounters(true) every scope also reads the hardware counters (Linux only, see PerfCounters.h),
+//summed per phase over windows of COUNTER_WINDOW frames.
+//Built with GRAVITY_TRACK_ALLOCATIONS, heap allocations are charged to the innermost scope (see AllocTracker.h)
+//and every frame that allocates after the body count has been stable for STEADY_FRAMES is flagged.
+//
+//	int gravityPhase = profiler.AddPhase("UpdateGravity");
+//	...
+//	{
+//		Profiler::Scope scope(profiler, gravityPhase);
+//		Body2D::UpdateGravity(b);
+//	}
+class Profiler {
+public:
+	typedef std::chrono::steady_clock Clock;
+	static const int HISTORY_FRAMES = 240;
+	static const size_t MAX_TRACE_EVENTS = 1 << 20; //24 MB of events, capture stops when full
+	static const int COUNTER_WINDOW = 60;
+	static const int STEADY_FRAMES = 60;
+	static const int ALLOC_BUCKETS = AllocTracker::MAX_PHASES + 2;
+
+	struct TraceEvent {
+		int phase;
+		int64_t startNs, durationNs;
+	};
+
+	//times the enclosing block for one phase
+	class Scope {
+	public:
+		Scope(Profiler &p, int phase) : profiler(p), phase(phase) {
+			outerPhase = AllocTracker::CurrentPhase();
+			AllocTracker::CurrentPhase() = phase;
+			if (profiler.countersEnabled) {
+				startCounters = profiler.counters.Read();
+			}
+			start = Clock::now();
+		}
+
+		~Scope() {
+			Clock::time_point end = Clock::now();
+			if (profiler.countersEnabled) {
+				profiler.windowCounters[phase] += profiler.counters.Read() - startCounters;
+			}
+			profiler.AddSample(phase, start, end);
+			AllocTracker::CurrentPhase() = outerPhase;
+		}
+
+	private:
+		Profiler &profiler;
+		int phase, outerPhase;
+		Clock::time_point start;
+		CounterValues startCounters;
+	};
+
+	Profiler() {
+		epoch = Clock::now();
+		frameStart = epoch;
+		frameHistory.assign(HISTORY_FRAMES, 0);
+		allocTotals.assign(ALLOC_BUCKETS, 0);
+		byteTotals.assign(ALLOC_BUCKETS, 0);
+		frameAllocs.assign(ALLOC_BUCKETS, 0);
+		frameAllocBytes.assign(ALLOC_BUCKETS, 0);
+		steadyAllocs.assign(ALLOC_BUCKETS, 0);
+	}
+
+	//call from the thread that opens the scopes, which need not be the one that constructed the profiler
+	//(olc runs the frame loop on its own EngineThread). its allocations outside scopes get their own bucket
+	void AttachThread() {
+		AllocTracker::CurrentPhase() = AllocTracker::NO_SCOPE;
+	}
+
+	//returns the id used by Scope, names must stay unique
+	int AddPhase(const std::string &name) {
+		names.push_back(name);
+		current.push_back(0);
+		history.push_back(std::vector<float>(HISTORY_FRAMES, 0));
+		windowCounters.push_back(CounterValues());
+		lastCounters.push_back(CounterValues());
+		return int(names.size() - 1);
+	}
+
+	void AddSample(int phase, Clock::time_point start, Clock::time_point end) {
+		int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		current[phase] += ns;
+		if (capturing) {
+			if (trace.size() < MAX_TRACE_EVENTS) {
+				trace.push_back(TraceEvent{ phase, std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count(), ns });
+			}
+			else {
+				capturing = false;
+			}
+		}
+	}
+
+	//closes the frame that started at the previous call and starts the next one
+	void NextFrame() {
+		Clock::time_point now = Clock::now();
+		int64_t frameNs = std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart).count();
+
+		frameHistory[head] = frameNs * 1e-6f;
+		for (size_t i = 0; i < names.size(); i++) {
+			history[i][head] = current[i] * 1e-6f;
+			current[i] = 0;
+		}
+		if (capturing) {
+			frames.push_back(TraceEvent{ -1, std::chrono::duration_cast<std::chrono::nanoseconds>(frameStart - epoch).count(), frameNs });
+		}
+
+		head = (head + 1) % HISTORY_FRAMES;
+		if (filled < HISTORY_FRAMES) {
+			filled++;
+		}
+
+		if (AllocTracker::ENABLED) {
+			CloseAllocFrame();
+		}
+
+		if (countersEnabled) {
+			windowFrames++;
+			windowBodyFrames += bodies;
+			if (windowFrames == COUNTER_WINDOW) {
+				lastCounters = windowCounters;
+				lastBodyFrames = windowBodyFrames;
+				ResetCounterWindow();
+			}
+		}
+		frameStart = now;
+	}
+
+	//false when perf_event_open is not available, the profiler keeps timing without counters
+	bool EnableCounters(bool on) {
+		if (on && !counters.IsOpen()) {
+			counters.Open();
+		}
+		else if (!on) {
+			counters.Close();
+		}
+		countersEnabled = counters.IsOpen();
+		ResetCounterWindow();
+		for (CounterValues &c : lastCounters) {
+			c = CounterValues();
+		}
+		lastBodyFrames = 0;
+		return countersEnabled;
+	}
+
+	bool CountersEnabled() { return countersEnabled; }
+
+	//body count of the open frame, used for the per body counter figures
+	void SetBodies(int n) { bodies = n; }
+
+	bool TracksAllocations() { return AllocTracker::ENABLED; }
+
+	//last completed frame, phase can also be AllocTracker::NO_SCOPE or AllocTracker::OTHER_THREADS
+	uint64_t FrameAllocs(int phase) { return frameAllocs[AllocTracker::Bucket(phase)]; }
+	uint64_t FrameAllocBytes(int phase) { return frameAllocBytes[AllocTracker::Bucket(phase)]; }
+
+	//true when the last completed frame was in steady state and allocated anyway
+	bool FrameFlagged() { return flagged; }
+	uint64_t SteadyAllocFrames() { return steadyAllocFrames; }
+	uint64_t SteadyAllocs(int phase) { return steadyAllocs[AllocTracker::Bucket(phase)]; }
+
+	int PhaseCount() { return int(names.size()); }
+	const std::string& PhaseName(int phase) { return names[phase]; }
+	int FramesStored() { return filled; }
+
+	//milliseconds, age 0 is the last completed frame
+	float PhaseMs(int phase, int age) { return history[phase][(head + HISTORY_FRAMES - 1 - age) % HISTORY_FRAMES]; }
+	float FrameMs(int age) { return frameHistory[(head + HISTORY_FRAMES - 1 - age) % HISTORY_FRAMES]; }
+
+	float AveragePhaseMs(int phase) {
+		float sum = 0;
+		for (int age = 0; age < filled; age++) {
+			sum += PhaseMs(phase, age);
+		}
+		return filled > 0 ? sum / filled : 0;
+	}
+
+	float AverageFrameMs() {
+		float sum = 0;
+		for (int age = 0; age < filled; age++) {
+			sum += FrameMs(age);
+		}
+		return filled > 0 ? sum / filled : 0;
+	}
+
+	//counter totals of one phase over the last completed window
+	const CounterValues& PhaseCounters(int phase) { return lastCounters[phase]; }
+
+	double CacheMissesPerBody(int phase) {
+		return lastBodyFrames > 0 ? double(lastCounters[phase].cacheMisses) / lastBodyFrames : 0;
+	}
+
+	double BranchMissesPerBody(int phase) {
+		return lastBodyFrames > 0 ? double(lastCounters[phase].branchMisses) / lastBodyFrames : 0;
+	}
+
+	void StartCapture() {
+		trace.clear();
+		frames.clear();
+		trace.reserve(MAX_TRACE_EVENTS / 16);
+		capturing = true;
+	}
+
+	bool Capturing() { return capturing; }
+
+	//stops the capture and writes it in the Chrome trace event format, timestamps are in microseconds
+	bool StopCapture(const std::string &path) {
+		capturing = false;
+		std::ofstream out(path);
+		if (!out.is_open()) {
+			return false;
+		}
+		out.setf(std::ios::fixed);
+		out.precision(3);
+		out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"EngineThread\"}}";
+		for (TraceEvent &e : frames) {
+			WriteEvent(out, "Frame", e);
+		}
+		for (TraceEvent &e : trace) {
+			WriteEvent(out, names[e.phase], e);
+		}
+		out << "\n]}\n";
+		return true;
+	}
+
+private:
+	std::vector<std::string> names;
+	std::vector<int64_t> current; //ns per phase in the open frame
+	std::vector<std::vector<float>> history; //ms per phase, ring of HISTORY_FRAMES
+	std::vector<float> frameHistory;
+	int head = 0, filled = 0;
+	Clock::time_point epoch, frameStart;
+
+	bool capturing = false;
+	std::vector<TraceEvent> trace, frames;
+
+	PerfCounters counters;
+	bool countersEnabled = false;
+	std::vector<CounterValues> windowCounters, lastCounters;
+	int windowFrames = 0, bodies = 0;
+	uint64_t windowBodyFrames = 0, lastBodyFrames = 0; //sum of the body count over the window's frames
+
+	//allocation state, indexed by AllocTracker::Bucket
+	std::vector<uint64_t> allocTotals, byteTotals, frameAllocs, frameAllocBytes, steadyAllocs;
+	int frameBodies = -1, stableFrames = 0;
+	uint64_t steadyAllocFrames = 0;
+	bool flagged = false;
+
+	void CloseAllocFrame() {
+		uint64_t total = 0;
+		for (int i = 0; i < ALLOC_BUCKETS; i++) {
+			AllocTracker::Counts &c = AllocTracker::Buckets()[i];
+			uint64_t allocs = c.allocs.load(std::memory_order_relaxed);
+			uint64_t bytes = c.bytes.load(std::memory_order_relaxed);
+			frameAllocs[i] = allocs - allocTotals[i];
+			frameAllocBytes[i] = bytes - byteTotals[i];
+			allocTotals[i] = allocs;
+			byteTotals[i] = bytes;
+			total += frameAllocs[i];
+		}
+
+		//bodies still holds the count this frame started with
+		stableFrames = (bodies == frameBodies) ? stableFrames + 1 : 0;
+		frameBodies = bodies;
+		flagged = stableFrames >= STEADY_FRAMES && total > 0;
+		if (flagged) {
+			steadyAllocFrames++;
+			for (int i = 0; i < ALLOC_BUCKETS; i++) {
+				steadyAllocs[i] += frameAllocs[i];
+			}
+		}
+	}
+
+	void ResetCounterWindow() {
+		for (CounterValues &c : windowCounters) {
+			c = CounterValues();
+		}
+		windowFrames = 0;
+		windowBodyFrames = 0;
+	}
+
+	static void WriteEvent(std::ofstream &out, const std::string &name, TraceEvent &e) {
+		out << ",\n{\"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << e.startNs / 1000.0
+			<< ", \"dur\": " << e.durationNs / 1000.0 << "}";
+	}
+};
@@ -0,0 +1,602 @@
+#pragma once
+#include "olcPixelGameEngine.h"
+#include "Physics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+//Software rasterizing straight into a sprite's pixels, for drawing thousands of bodies a frame.
+//olc's FillCircle goes through Draw() for every pixel, which checks the draw target, the pixel mode and the bounds
+//each time, and walks the whole circle even when nearly all of it is off screen. Here a circle is clipped to the
+//target first and every visible scanline is one fill of 32 bit pixels, which the compiler turns into vector stores.
+//Only the NORMAL pixel mode is handled, anything that blends still goes through olc. TiledCircles spreads that
+//over threads by screen tile. DrawLine is the same for one pixel lines, clipped before they are walked, and Arrows
+//batches the velocity and acceleration overlay into those lines.
+//CircleAtlas is the GPU alternative, bodies drawn as decals cost the same whatever their size on screen.
+//DensitySplat is for views with far more bodies than pixels, it draws how much mass is where instead of bodies.
+namespace Raster {
+
+	const float MAX_RADIUS = 1 << 24; //larger circles are clamped, they cover any screen anyway
+
+	//the pixels of a sprite and the rectangle of it that may be written, x1 and y1 are exclusive.
+	//whatever is written is marked dirty on the sprite, so olc clears and uploads it
+	struct Target {
+		olc::Sprite* sprite = nullptr;
+		uint32_t* data = nullptr;
+		int width = 0, height = 0;
+		int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+		Target() = default;
+
+		explicit Target(olc::Sprite* sprite) {
+			if (sprite != nullptr) {
+				this->sprite = sprite;
+				data = (uint32_t*)sprite->GetData();
+				width = sprite->width;
+				height = sprite->height;
+				x1 = width;
+				y1 = height;
+			}
+		}
+
+		//narrows the writable rectangle, never beyond the sprite
+		void Clip(int left, int top, int right, int bottom) {
+			x0 = std::max(left, 0);
+			y0 = std::max(top, 0);
+			x1 = std::min(right, width);
+			y1 = std::min(bottom, height);
+		}
+	};
+
+	inline int64_t ISqrt(int64_t v) {
+		if (v <= 0) {
+			return 0;
+		}
+		int64_t s = int64_t(std::sqrt(double(v)));
+		while (s * s > v) {
+			s--;
+		}
+		while ((s + 1) * (s + 1) <= v) {
+			s++;
+		}
+		return s;
+	}
+
+	//same footprint as olc::FillCircle to within a pixel on the rim: centre and radius truncate to whole pixels
+	//and radius 0 draws nothing. cost is the visible rows, not the size of the circle
+	inline void FillCircle(const Target &t, float cx, float cy, float radius, olc::Pixel p) {
+		if (!(radius >= 1) || t.data == nullptr) {
+			return;
+		}
+		float r = std::min(radius, MAX_RADIUS);
+		if (!(cx + r >= t.x0 && cx - r < t.x1 && cy + r >= t.y0 && cy - r < t.y1)) {
+			return; //also rejects NaN
+		}
+		int64_t ir = int64_t(r);
+		int64_t x = int64_t(cx), y = int64_t(cy);
+		int64_t top = std::max<int64_t>(y - ir, t.y0), bottom = std::min<int64_t>(y + ir, t.y1 - 1);
+		int64_t rr = ir * ir + ir; //the midpoint circle olc uses sits about half a pixel outside r
+		int64_t dirtyLeft = t.x1, dirtyRight = -1;
+		for (int64_t row = top; row <= bottom; row++) {
+			int64_t dy = row - y;
+			int64_t half = ISqrt(rr - dy * dy);
+			int64_t left = std::max<int64_t>(x - half, t.x0), right = std::min<int64_t>(x + half, t.x1 - 1);
+			if (left <= right) {
+				std::fill_n(t.data + row * t.width + left, right - left + 1, p.n);
+				dirtyLeft = std::min(dirtyLeft, left);
+				dirtyRight = std::max(dirtyRight, right);
+			}
+		}
+		if (t.sprite != nullptr && dirtyLeft <= dirtyRight) {
+			t.sprite->MarkDirty(int32_t(dirtyLeft), int32_t(top), int32_t(dirtyRight), int32_t(bottom));
+		}
+	}
+
+	const int LINE_DIRTY_RUN = 32; //pixels of a line marked dirty together, the box of a long diagonal is most of the screen
+
+	//one edge of liang-barsky clipping, narrows [enter, leave] to the side of the edge the line may be on
+	inline bool ClipEdge(float p, float q, float &enter, float &leave) {
+		if (p == 0) {
+			return q >= 0;
+		}
+		float r = q / p;
+		if (p < 0) {
+			enter = std::max(enter, r);
+		}
+		else {
+			leave = std::min(leave, r);
+		}
+		return enter <= leave;
+	}
+
+	//ends truncate to whole pixels and both are drawn like olc::DrawLine, the steps in between can tie break the
+	//other way. the line is clipped before it is walked, so a line mostly off screen costs the part that is on it
+	inline void DrawLine(const Target &t, float ax, float ay, float bx, float by, olc::Pixel p) {
+		if (t.data == nullptr || t.x0 >= t.x1 || t.y0 >= t.y1) {
+			return;
+		}
+		if (!(std::isfinite(ax) && std::isfinite(ay) && std::isfinite(bx) && std::isfinite(by))) {
+			return;
+		}
+		float dx = bx - ax, dy = by - ay;
+		float enter = 0, leave = 1;
+		if (!ClipEdge(-dx, ax - t.x0, enter, leave) || !ClipEdge(dx, t.x1 - ax, enter, leave) ||
+			!ClipEdge(-dy, ay - t.y0, enter, leave) || !ClipEdge(dy, t.y1 - ay, enter, leave)) {
+			return;
+		}
+		//the clipped ends can land on the exclusive edge, pulling them in moves the line by less than a pixel
+		int x = std::min(std::max(int(ax + enter * dx), t.x0), t.x1 - 1), y = std::min(std::max(int(ay + enter * dy), t.y0), t.y1 - 1);
+		int xe = std::min(std::max(int(ax + leave * dx), t.x0), t.x1 - 1), ye = std::min(std::max(int(ay + leave * dy), t.y0), t.y1 - 1);
+
+		//bresenham, the dirty box of every run of pixels is its first and last pixel
+		int stepX = x < xe ? 1 : -1, stepY = y < ye ? 1 : -1;
+		int spanX = std::abs(xe - x), spanY = -std::abs(ye - y), err = spanX + spanY;
+		int runX = x, runY = y, run = 0;
+		while (true) {
+			t.data[size_t(y) * t.width + x] = p.n;
+			bool last = x == xe && y == ye;
+			if ((++run == LINE_DIRTY_RUN || last) && t.sprite != nullptr) {
+				t.sprite->MarkDirty(std::min(runX, x), std::min(runY, y), std::max(runX, x), std::max(runY, y));
+			}
+			if (last) {
+				return;
+			}
+			int e2 = 2 * err;
+			if (e2 >= spanY) {
+				err += spanY;
+				x += stepX;
+			}
+			if (e2 <= spanX) {
+				err += spanX;
+				y += stepY;
+			}
+			if (run == LINE_DIRTY_RUN) {
+				run = 0;
+				runX = x;
+				runY = y;
+			}
+		}
+	}
+
+	const float ARROWHEAD_COS = 0.8660254f, ARROWHEAD_SIN = 0.5f; //barbs 30 degrees either side of the shaft
+	const float ARROWHEAD_MAX = 20; //world units
+	const float MIN_ARROW_PIXELS = 1; //shorter arrows are not drawn
+
+	//arrows given in world units, laid out on screen in one pass over arrays of their ends and drawn as one batch of
+	//lines. the barbs are the unit direction of the shaft turned by a fixed rotation, no angles are taken. arrows
+	//shorter than a pixel or entirely off the target are left out by the same pass
+	class Arrows {
+	public:
+		void Clear() {
+			x0.clear(); y0.clear(); x1.clear(); y1.clear();
+			colors.clear();
+		}
+
+		void Add(float fromX, float fromY, float toX, float toY, olc::Pixel p) {
+			x0.push_back(fromX); y0.push_back(fromY);
+			x1.push_back(toX); y1.push_back(toY);
+			colors.push_back(p);
+		}
+
+		//world to screen is pos * zoom + offset, culled against [0, width) x [0, height)
+		void Layout(float zoom, float offsetX, float offsetY, int width, int height) {
+			size_t len = x0.size();
+			sx0.resize(len); sy0.resize(len); sx1.resize(len); sy1.resize(len);
+			hx0.resize(len); hy0.resize(len); hx1.resize(len); hy1.resize(len);
+			keep.resize(len);
+			LayoutRange(len, x0.data(), y0.data(), x1.data(), y1.data(), zoom, offsetX, offsetY, float(width), float(height),
+				sx0.data(), sy0.data(), sx1.data(), sy1.data(), hx0.data(), hy0.data(), hx1.data(), hy1.data(), keep.data());
+		}
+
+		//every line of the arrows kept by Layout(), shaft then both barbs
+		template <typename LineFn> void Lines(LineFn line) {
+			size_t len = keep.size();
+			for (size_t i = 0; i < len; i++) {
+				if (keep[i]) {
+					line(sx0[i], sy0[i], sx1[i], sy1[i], colors[i]);
+					line(sx1[i], sy1[i], hx0[i], hy0[i], colors[i]);
+					line(sx1[i], sy1[i], hx1[i], hy1[i], colors[i]);
+				}
+			}
+		}
+
+		void Draw(const Target &t) {
+			Lines([&t](float ax, float ay, float bx, float by, olc::Pixel p) { DrawLine(t, ax, ay, bx, by, p); });
+		}
+
+	private:
+		std::vector<float> x0, y0, x1, y1; //world
+		std::vector<olc::Pixel> colors;
+		std::vector<float> sx0, sy0, sx1, sy1, hx0, hy0, hx1, hy1; //screen, shaft and barb ends
+		std::vector<uint8_t> keep;
+
+		//the columns are __restrict parameters and the body has selects only, so with -O3 -fno-math-errno this loop
+		//vectorises. the barb length is the arrow's squared length / 100 up to ARROWHEAD_MAX, 0.1 under 15
+		static void LayoutRange(size_t len, const float* __restrict x0, const float* __restrict y0, const float* __restrict x1,
+			const float* __restrict y1, float zoom, float offsetX, float offsetY, float width, float height,
+			float* __restrict sx0, float* __restrict sy0, float* __restrict sx1, float* __restrict sy1, float* __restrict hx0,
+			float* __restrict hy0, float* __restrict hx1, float* __restrict hy1, uint8_t* __restrict keep) {
+			for (size_t i = 0; i < len; i++) {
+				float dx = x1[i] - x0[i], dy = y1[i] - y0[i];
+				float lenSquared = dx * dx + dy * dy;
+				float head = std::min(lenSquared / 100, ARROWHEAD_MAX);
+				head = lenSquared < 15 ? 0.1f : head;
+				float inv = 1 / sqrtf(lenSquared + (lenSquared == 0 ? 1.0f : 0.0f)); //a 0 length arrow is culled anyway
+				float ux = dx * inv, uy = dy * inv;
+
+				float ax = x0[i] * zoom + offsetX, ay = y0[i] * zoom + offsetY;
+				float bx = x1[i] * zoom + offsetX, by = y1[i] * zoom + offsetY;
+				float reach = head * zoom;
+				sx0[i] = ax; sy0[i] = ay;
+				sx1[i] = bx; sy1[i] = by;
+				hx0[i] = bx - reach * (ux * ARROWHEAD_COS + uy * ARROWHEAD_SIN);
+				hy0[i] = by - reach * (uy * ARROWHEAD_COS - ux * ARROWHEAD_SIN);
+				hx1[i] = bx - reach * (ux * ARROWHEAD_COS - uy * ARROWHEAD_SIN);
+				hy1[i] = by - reach * (uy * ARROWHEAD_COS + ux * ARROWHEAD_SIN);
+
+				//the barbs stay within reach of the tip. comparisons with NaN are false, so those are culled too
+				bool visible = (std::min(ax, bx - reach) < width) & (std::max(ax, bx + reach) >= 0) &
+					(std::min(ay, by - reach) < height) & (std::max(ay, by + reach) >= 0);
+				bool large = lenSquared * zoom * zoom >= MIN_ARROW_PIXELS * MIN_ARROW_PIXELS;
+				keep[i] = uint8_t(visible & large);
+			}
+		}
+	};
+
+	const int TILE_SIZE = 64; //pixels a side
+	const int TILE_CIRCLES_PER_THREAD = 2048; //fewer are drawn on the calling thread
+
+	//circles drawn by several threads at once. the target is cut into tiles and every circle is binned to the tiles
+	//its rows touch, then each thread fills whole tiles through a target clipped to them. tiles never overlap, so
+	//nothing is shared while drawing, and every tile draws its circles in the order they were added, so the pixels
+	//come out the same as drawing them one after the other on one thread
+	class TiledCircles {
+	public:
+		void Clear() {
+			circles.clear();
+		}
+
+		void Add(float x, float y, float radius, olc::Pixel p) {
+			circles.push_back(Circle{ x, y, radius, p });
+		}
+
+		void Draw(const Target &t, int threads) {
+			int len = circles.size();
+			threads = std::max(1, std::min(threads, len / TILE_CIRCLES_PER_THREAD));
+			if (threads == 1 || t.data == nullptr) {
+				for (const Circle &c : circles) {
+					FillCircle(t, c.x, c.y, c.radius, c.color);
+				}
+				return;
+			}
+
+			tilesX = (t.width + TILE_SIZE - 1) / TILE_SIZE;
+			tilesY = (t.height + TILE_SIZE - 1) / TILE_SIZE;
+			Bin(t);
+			std::vector<std::thread> workers;
+			for (int w = 0; w < threads; w++) {
+				workers.push_back(std::thread(&TiledCircles::DrawTiles, this, std::cref(t), w, threads));
+			}
+			for (std::thread &worker : workers) {
+				worker.join();
+			}
+		}
+
+	private:
+		struct Circle {
+			float x, y, radius;
+			olc::Pixel color;
+		};
+
+		std::vector<Circle> circles;
+		std::vector<int> binStart; //circles of tile k are binned[binStart[k], binStart[k + 1])
+		std::vector<int> binned;
+		int tilesX = 0, tilesY = 0;
+
+		//the tiles a circle can write to, false when FillCircle would draw nothing
+		static bool TileRange(const Target &t, const Circle &c, int &tx0, int &ty0, int &tx1, int &ty1) {
+			if (!(c.radius >= 1)) {
+				return false;
+			}
+			float r = std::min(c.radius, MAX_RADIUS);
+			if (!(c.x + r >= t.x0 && c.x - r < t.x1 && c.y + r >= t.y0 && c.y - r < t.y1)) {
+				return false;
+			}
+			int64_t ir = int64_t(r), x = int64_t(c.x), y = int64_t(c.y);
+			int64_t left = std::max<int64_t>(x - ir, t.x0), right = std::min<int64_t>(x + ir, t.x1 - 1);
+			int64_t top = std::max<int64_t>(y - ir, t.y0), bottom = std::min<int64_t>(y + ir, t.y1 - 1);
+			if (left > right || top > bottom) {
+				return false;
+			}
+			tx0 = int(left / TILE_SIZE); tx1 = int(right / TILE_SIZE);
+			ty0 = int(top / TILE_SIZE); ty1 = int(bottom / TILE_SIZE);
+			return true;
+		}
+
+		//counting sort by tile, a circle that touches several tiles is in each of them
+		void Bin(const Target &t) {
+			int len = circles.size(), tiles = tilesX * tilesY;
+			binStart.assign(tiles + 1, 0);
+			int tx0, ty0, tx1, ty1;
+			for (int counter = 0; counter < len; counter++) {
+				if (TileRange(t, circles[counter], tx0, ty0, tx1, ty1)) {
+					for (int ty = ty0; ty <= ty1; ty++) {
+						for (int tx = tx0; tx <= tx1; tx++) {
+							binStart[ty * tilesX + tx + 1]++;
+						}
+					}
+				}
+			}
+			for (int tile = 0; tile < tiles; tile++) {
+				binStart[tile + 1] += binStart[tile];
+			}
+			binned.resize(binStart[tiles]);
+			std::vector<int> next(binStart.begin(), binStart.end() - 1);
+			for (int counter = 0; counter < len; counter++) {
+				if (TileRange(t, circles[counter], tx0, ty0, tx1, ty1)) {
+					for (int ty = ty0; ty <= ty1; ty++) {
+						for (int tx = tx0; tx <= tx1; tx++) {
+							binned[next[ty * tilesX + tx]++] = counter;
+						}
+					}
+				}
+			}
+		}
+
+		//every threads-th tile starting at first, so a crowded part of the screen is shared between threads
+		void DrawTiles(const Target &t, int first, int threads) {
+			for (int tile = first; tile < tilesX * tilesY; tile += threads) {
+				int left = (tile % tilesX) * TILE_SIZE, top = (tile / tilesX) * TILE_SIZE;
+				Target clipped = t;
+				clipped.Clip(std::max(left, t.x0), std::max(top, t.y0), std::min(left + TILE_SIZE, t.x1), std::min(top + TILE_SIZE, t.y1));
+				for (int i = binStart[tile]; i < binStart[tile + 1]; i++) {
+					const Circle &c = circles[binned[i]];
+					FillCircle(clipped, c.x, c.y, c.radius, c.color);
+				}
+			}
+		}
+	};
+
+	const int ATLAS_LEVELS = 6;
+	const int ATLAS_MIN_RADIUS = 4; //level k is a disc of radius ATLAS_MIN_RADIUS << k
+	const int ATLAS_SAMPLES = 4; //per pixel and axis, for the coverage of the rim
+
+	//white anti-aliased discs of a few sizes side by side, alpha is coverage, for drawing bodies as tinted decals.
+	//every disc has a pixel of space around it so sampling one never picks up its neighbour
+	class CircleAtlas {
+	public:
+		olc::Sprite* sprite = nullptr;
+		olc::Decal* decal = nullptr;
+
+		CircleAtlas() = default;
+		CircleAtlas(const CircleAtlas&) = delete; //owns the sprite and decal
+		CircleAtlas& operator=(const CircleAtlas&) = delete;
+
+		~CircleAtlas() {
+			delete sprite;
+		}
+
+		//the decal's texture must go while the GL context is still current, so not in the destructor
+		void Release() {
+			delete decal;
+			decal = nullptr;
+		}
+
+		//needs the renderer, so call it from OnUserCreate
+		void Build() {
+			int width = 0;
+			for (int level = 0; level < ATLAS_LEVELS; level++) {
+				left[level] = width + 1;
+				width += 2 * Radius(level) + 2;
+			}
+			int height = 2 * Radius(ATLAS_LEVELS - 1) + 2;
+			sprite = new olc::Sprite(width, height);
+			std::fill_n((uint32_t*)sprite->GetData(), width * height, olc::BLANK.n);
+
+			for (int level = 0; level < ATLAS_LEVELS; level++) {
+				int r = Radius(level);
+				for (int y = 0; y < 2 * r; y++) {
+					for (int x = 0; x < 2 * r; x++) {
+						int inside = 0;
+						for (int sy = 0; sy < ATLAS_SAMPLES; sy++) {
+							for (int sx = 0; sx < ATLAS_SAMPLES; sx++) {
+								float dx = x + (sx + 0.5f) / ATLAS_SAMPLES - r, dy = y + (sy + 0.5f) / ATLAS_SAMPLES - r;
+								inside += dx * dx + dy * dy <= float(r * r);
+							}
+						}
+						uint8_t alpha = uint8_t(inside * 255 / (ATLAS_SAMPLES * ATLAS_SAMPLES));
+						sprite->SetPixel(left[level] + x, 1 + y, olc::Pixel(255, 255, 255, alpha));
+					}
+				}
+			}
+			decal = new olc::Decal(sprite);
+		}
+
+		static int Radius(int level) {
+			return ATLAS_MIN_RADIUS << level;
+		}
+
+		//the smallest disc at least radius pixels across so it is only ever scaled down, the largest for bigger bodies
+		static int Level(float radius) {
+			int level = 0;
+			while (level < ATLAS_LEVELS - 1 && float(Radius(level)) < radius) {
+				level++;
+			}
+			return level;
+		}
+
+		olc::vf2d Position(int level) const {
+			return olc::vf2d(float(left[level]), 1.0f);
+		}
+
+	private:
+		int left[ATLAS_LEVELS] = {};
+	};
+
+	const int SPLAT_BODIES_PER_THREAD = 16384; //fewer are splatted on the calling thread
+	const int RAMP_SIZE = 256;
+
+	//log2 to within 0.09 from the float's exponent and mantissa, plenty for picking a colour and far cheaper than log
+	inline float FastLog2(float v) {
+		uint32_t bits;
+		memcpy(&bits, &v, 4);
+		return float(bits) * (1.0f / (1 << 23)) - 127;
+	}
+
+	//accumulates the mass of bodies into a screen sized buffer and tone maps it onto the target.
+	//every thread splats its share of the bodies into a buffer of its own, so there are no atomics. the tone map
+	//then sums those buffers row by row, on every thread as well, and clears them again for the next frame
+	class DensitySplat {
+	public:
+		//mass of b[indices] at screen position pos * zoom + offset, each body into the pixel it falls in.
+		//spreading bodies over four pixels looked smoother but the extra scattered writes cost half again as much
+		void Accumulate(const std::vector<Body2D> &b, const std::vector<int> &indices, float zoom, float offsetX, float offsetY,
+			int width, int height, int threads) {
+			int len = indices.size();
+			threads = std::max(1, std::min(threads, len / SPLAT_BODIES_PER_THREAD));
+			if (width != bufferWidth || height != bufferHeight || int(buffers.size()) < threads) {
+				bufferWidth = width;
+				bufferHeight = height;
+				buffers.resize(std::max(int(buffers.size()), threads));
+				for (std::vector<float> &buffer : buffers) {
+					buffer.assign(size_t(width) * height, 0.0f);
+				}
+			}
+			used = std::max(used, threads);
+			if (threads == 1) {
+				SplatRange(b, indices, 0, len, zoom, offsetX, offsetY, buffers[0]);
+				return;
+			}
+			std::vector<std::thread> workers;
+			for (int t = 0; t < threads; t++) {
+				workers.push_back(std::thread(&DensitySplat::SplatRange, this, std::cref(b), std::cref(indices),
+					int((long long)len * t / threads), int((long long)len * (t + 1) / threads), zoom, offsetX, offsetY, std::ref(buffers[t])));
+			}
+			for (std::thread &worker : workers) {
+				worker.join();
+			}
+		}
+
+		//writes every pixel that got any mass, log scaled against the densest pixel of the previous frame so the
+		//exposure follows the view without a second pass. pixels without mass keep what the target had.
+		//with no previous peak (the first frame, or the last view was empty) this frame's own is found first
+		void Resolve(const Target &t, int threads) {
+			if (ramp.empty()) {
+				BuildRamp();
+			}
+			int rows = std::min(t.height, bufferHeight);
+			threads = std::max(1, std::min(threads, rows / 16));
+			std::vector<float> peaks(threads, 0.0f);
+			if (peak == 0) {
+				peak = FramePeak(t, rows);
+			}
+			float scale = (RAMP_SIZE - 1) / std::max(FastLog2(1 + peak), 1e-6f);
+			if (threads == 1) {
+				ResolveRows(t, 0, rows, scale, peaks[0]);
+			}
+			else {
+				//split on dirty tile rows so no two threads mark the same tile
+				auto split = [&](int w) { return w == threads ? rows : (rows * w / threads) >> olc::nDirtyTileShift << olc::nDirtyTileShift; };
+				std::vector<std::thread> workers;
+				for (int w = 0; w < threads; w++) {
+					workers.push_back(std::thread(&DensitySplat::ResolveRows, this, std::cref(t), split(w), split(w + 1), scale, std::ref(peaks[w])));
+				}
+				for (std::thread &worker : workers) {
+					worker.join();
+				}
+			}
+			peak = *std::max_element(peaks.begin(), peaks.end());
+			used = 0;
+		}
+
+	private:
+		std::vector<std::vector<float>> buffers; //one per thread, zero between frames
+		int bufferWidth = 0, bufferHeight = 0;
+		int used = 0; //buffers written since the last resolve
+		float peak = 0;
+		std::vector<uint32_t> ramp;
+
+		void SplatRange(const std::vector<Body2D> &b, const std::vector<int> &indices, int begin, int end, float zoom,
+			float offsetX, float offsetY, std::vector<float> &buffer) {
+			for (int counter = begin; counter < end; counter++) {
+				const Body2D &body = b[indices[counter]];
+				float weight = body.mass > 0 ? float(body.mass) : 1.0f;
+				float px = body.pos.x * zoom + offsetX, py = body.pos.y * zoom + offsetY;
+				if (px >= 0 && py >= 0 && px < bufferWidth && py < bufferHeight) {
+					buffer[size_t(py) * bufferWidth + size_t(px)] += weight;
+				}
+			}
+		}
+
+		//densest pixel inside t summed over the buffers, without touching them
+		float FramePeak(const Target &t, int rows) {
+			float framePeak = 0;
+			int x0 = std::max(0, t.x0), x1 = std::min(std::min(t.width, bufferWidth), t.x1);
+			for (int y = std::max(0, t.y0); y < std::min(rows, t.y1); y++) {
+				for (int x = x0; x < x1; x++) {
+					float d = 0;
+					for (int counter = 0; counter < used; counter++) {
+						d += buffers[counter][size_t(y) * bufferWidth + x];
+					}
+					framePeak = std::max(framePeak, d);
+				}
+			}
+			return framePeak;
+		}
+
+		//folds the other buffers into the first one row by row, then maps that row and clears it
+		void ResolveRows(const Target &t, int begin, int end, float scale, float &rowsPeak) {
+			int x0 = std::max(0, t.x0), x1 = std::min(std::min(t.width, bufferWidth), t.x1);
+			for (int y = std::max(begin, t.y0); y < std::min(end, t.y1); y++) {
+				float* row = buffers[0].data() + size_t(y) * bufferWidth;
+				for (int counter = 1; counter < used; counter++) {
+					float* other = buffers[counter].data() + size_t(y) * bufferWidth;
+					for (int x = x0; x < x1; x++) {
+						row[x] += other[x];
+						other[x] = 0;
+					}
+				}
+				uint32_t* out = t.data + size_t(y) * t.width;
+				int dirtyLeft = x1, dirtyRight = -1;
+				for (int x = x0; x < x1; x++) {
+					float d = row[x];
+					if (d > 0) {
+						rowsPeak = std::max(rowsPeak, d);
+						out[x] = ramp[int(std::min(FastLog2(1 + d) * scale, float(RAMP_SIZE - 1)))];
+						row[x] = 0;
+						dirtyLeft = std::min(dirtyLeft, x);
+						dirtyRight = x;
+					}
+				}
+				if (t.sprite != nullptr && dirtyLeft <= dirtyRight) {
+					t.sprite->MarkDirty(dirtyLeft, y, dirtyRight, y);
+				}
+			}
+		}
+
+		//black through blue and orange to white
+		void BuildRamp() {
+			const float stops[5][3] = { { 0, 0, 0 }, { 40, 30, 140 }, { 210, 90, 40 }, { 255, 210, 110 }, { 255, 255, 255 } };
+			ramp.resize(RAMP_SIZE);
+			for (int level = 0; level < RAMP_SIZE; level++) {
+				float f = level * 4.0f / (RAMP_SIZE - 1);
+				int stop = std::min(int(f), 3);
+				float u = f - stop;
+				uint8_t rgb[3];
+				for (int c = 0; c < 3; c++) {
+					rgb[c] = uint8_t(stops[stop][c] + (stops[stop + 1][c] - stops[stop][c]) * u);
+				}
+				//the weakest pixels still show
+				if (level > 0) {
+					rgb[0] = std::max(rgb[0], uint8_t(24));
+					rgb[1] = std::max(rgb[1], uint8_t(20));
+					rgb[2] = std::max(rgb[2], uint8_t(60));
+				}
+				ramp[level] = olc::Pixel(rgb[0], rgb[1], rgb[2]).n;
+			}
+		}
+	};
+}
@@ -0,0 +1,382 @@
+#pragma once
+#include "SpscRing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Trajectory file layout (all integers little endian):
+//
+//	file header:	"G2DT" | u32 version | u32 framesPerChunk
+//	chunk:			"CHNK" | u64 firstStep | u32 frameCount | u32 bodyCount
+//					| f32 minX | f32 minY | f32 maxX | f32 maxY | u32 payloadBytes | payload
+//	index (on close):	"INDX" | u32 chunkCount | chunkCount * (u64 offset | u64 firstStep | u64 lastStep | u32 frameCount)
+//	trailer:			u64 index offset | "G2DI"
+//
+//payload:
+//	per body, once per chunk:	varint radius | zigzag varint mass | u32 color
+//	per frame:					varint step delta from the previous frame (from firstStep for frame 0)
+//	frame 0 (keyframe):			u16 qx | u16 qy for every body
+//	frame n > 0:				zigzag varint (qx - prev qx) | zigzag varint (qy - prev qy) for every body
+//
+//positions are quantized to 16 bits inside the chunk bounds, so the error is at most (max - min) / 131070.
+//a chunk is closed early whenever the body count or any body's mass, radius or colour changes, bodies only get
+//reordered when one is removed, so inside a chunk index i is always the same body and the deltas stay small.
+//every chunk starts with a keyframe, so seeking never decodes more than one chunk.
+//a file without a trailer (recorder killed) can still be read by scanning the chunks.
+
+namespace Trajectory {
+
+	const char FILE_MAGIC[4] = { 'G', '2', 'D', 'T' };
+	const char CHUNK_MAGIC[4] = { 'C', 'H', 'N', 'K' };
+	const char INDEX_MAGIC[4] = { 'I', 'N', 'D', 'X' };
+	const char TRAILER_MAGIC[4] = { 'G', '2', 'D', 'I' };
+	const size_t FILE_HEADER_BYTES = 12;
+	const size_t CHUNK_HEADER_BYTES = 40;
+	const size_t TRAILER_BYTES = 12;
+	const uint32_t VERSION = 1;
+	const uint32_t QUANT_MAX = 65535;
+
+	//one simulation step worth of bodies, slots of these are reused so the vectors only grow
+	struct Frame {
+		uint64_t step = 0;
+		uint32_t count = 0;
+		std::vector<float> x, y;
+		std::vector<int> mass, radius;
+		std::vector<uint32_t> color;
+
+		void Resize(uint32_t n) {
+			count = n;
+			if (x.size() < n) {
+				x.resize(n); y.resize(n);
+				mass.resize(n); radius.resize(n);
+				color.resize(n);
+			}
+		}
+
+		//same count, masses, radii and colours, positions aside
+		bool SameBodies(const Frame &other) const {
+			uint32_t n = count;
+			return n == other.count && std::equal(mass.begin(), mass.begin() + n, other.mass.begin())
+				&& std::equal(radius.begin(), radius.begin() + n, other.radius.begin())
+				&& std::equal(color.begin(), color.begin() + n, other.color.begin());
+		}
+	};
+
+	//where each chunk lives in the file
+	struct IndexEntry {
+		uint64_t offset = 0;
+		uint64_t firstStep = 0;
+		uint64_t lastStep = 0;
+		uint32_t frameCount = 0;
+	};
+
+	//byte helpers shared by the writer and the reader
+	inline void PutU16(std::vector<uint8_t> &out, uint16_t v) {
+		out.push_back(uint8_t(v));
+		out.push_back(uint8_t(v >> 8));
+	}
+
+	inline void PutU32(std::vector<uint8_t> &out, uint32_t v) {
+		for (int i = 0; i < 4; i++) {
+			out.push_back(uint8_t(v >> (8 * i)));
+		}
+	}
+
+	inline void PutU64(std::vector<uint8_t> &out, uint64_t v) {
+		for (int i = 0; i < 8; i++) {
+			out.push_back(uint8_t(v >> (8 * i)));
+		}
+	}
+
+	inline void PutF32(std::vector<uint8_t> &out, float f) {
+		uint32_t v;
+		memcpy(&v, &f, 4);
+		PutU32(out, v);
+	}
+
+	inline void PutVarint(std::vector<uint8_t> &out, uint64_t v) {
+		while (v >= 0x80) {
+			out.push_back(uint8_t(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back(uint8_t(v));
+	}
+
+	inline uint32_t ZigZag(int32_t v) {
+		return (uint32_t(v) << 1) ^ uint32_t(v >> 31);
+	}
+
+	inline int32_t UnZigZag(uint32_t v) {
+		return int32_t(v >> 1) ^ -int32_t(v & 1);
+	}
+
+	inline uint16_t GetU16(const uint8_t *&p) {
+		uint16_t v = uint16_t(p[0] | (p[1] << 8));
+		p += 2;
+		return v;
+	}
+
+	inline uint32_t GetU32(const uint8_t *&p) {
+		uint32_t v = uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+		p += 4;
+		return v;
+	}
+
+	inline uint64_t GetU64(const uint8_t *&p) {
+		uint64_t lo = GetU32(p);
+		uint64_t hi = GetU32(p);
+		return lo | (hi << 32);
+	}
+
+	inline float GetF32(const uint8_t *&p) {
+		uint32_t v = GetU32(p);
+		float f;
+		memcpy(&f, &v, 4);
+		return f;
+	}
+
+	inline uint64_t GetVarint(const uint8_t *&p, const uint8_t *end) {
+		uint64_t v = 0;
+		int shift = 0;
+		while (p < end && shift < 64) { //a longer run of continuation bytes is a damaged file
+			uint8_t byte = *p++;
+			v |= uint64_t(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				break;
+			}
+			shift += 7;
+		}
+		return v;
+	}
+
+	//the physics thread fills a slot in place and publishes it, it never waits on the writer
+	typedef SpscRing<Frame> FrameQueue;
+
+	//Records frames to disk on a background thread.
+	//Usage from the physics loop: Frame* f = rec.BeginFrame(); fill f; rec.CommitFrame();
+	class Recorder {
+	public:
+		Recorder(size_t queueFrames = 256) : queue(queueFrames) {}
+
+		~Recorder() {
+			Close();
+		}
+
+		bool Open(const std::string &path, uint32_t framesPerChunk = 64) {
+			Close();
+			file.open(path, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				return false;
+			}
+			this->framesPerChunk = std::max(1u, framesPerChunk);
+
+			std::vector<uint8_t> header;
+			header.insert(header.end(), FILE_MAGIC, FILE_MAGIC + 4);
+			PutU32(header, VERSION);
+			PutU32(header, this->framesPerChunk);
+			file.write((const char*)header.data(), header.size());
+			bytesWritten = header.size();
+
+			framesRecorded = 0;
+			framesDropped = 0;
+			chunkFrames = 0;
+			index.clear();
+			running = true;
+			writer = std::thread(&Recorder::WriterThread, this);
+			return true;
+		}
+
+		//drains everything still queued, writes the last chunk and closes the file
+		void Close() {
+			if (!writer.joinable()) {
+				return;
+			}
+			running = false;
+			writer.join();
+			WriteIndex();
+			file.close();
+		}
+
+		bool IsOpen() {
+			return writer.joinable();
+		}
+
+		//returns a slot to fill, or nullptr if the writer has fallen behind and this frame must be dropped
+		Frame* BeginFrame() {
+			Frame* f = queue.BeginPush();
+			if (f == nullptr) {
+				framesDropped++;
+			}
+			return f;
+		}
+
+		//batch runs want every frame, this waits for the writer instead of dropping
+		Frame* WaitFrame() {
+			Frame* f = queue.BeginPush();
+			while (f == nullptr) {
+				std::this_thread::yield();
+				f = queue.BeginPush();
+			}
+			return f;
+		}
+
+		void CommitFrame() {
+			queue.CommitPush();
+			framesRecorded++;
+		}
+
+		uint64_t FramesRecorded() { return framesRecorded; }
+		uint64_t FramesDropped() { return framesDropped; }
+		uint64_t BytesWritten() { return bytesWritten; }
+
+	private:
+		std::ofstream file;
+		std::atomic<uint64_t> bytesWritten{ 0 };
+		FrameQueue queue;
+		std::thread writer;
+		std::atomic<bool> running{ false };
+		std::atomic<uint64_t> framesRecorded{ 0 };
+		std::atomic<uint64_t> framesDropped{ 0 };
+		uint32_t framesPerChunk = 64;
+
+		//writer thread state, the chunk is kept as floats until it is full so the bounds are known
+		std::vector<Frame> chunk;
+		uint32_t chunkFrames = 0;
+		std::vector<uint8_t> out;
+		std::vector<uint16_t> qPrev, qCur;
+		std::vector<IndexEntry> index;
+
+		void WriteIndex() {
+			std::vector<uint8_t> bytes;
+			bytes.insert(bytes.end(), INDEX_MAGIC, INDEX_MAGIC + 4);
+			PutU32(bytes, uint32_t(index.size()));
+			for (IndexEntry &e : index) {
+				PutU64(bytes, e.offset);
+				PutU64(bytes, e.firstStep);
+				PutU64(bytes, e.lastStep);
+				PutU32(bytes, e.frameCount);
+			}
+			PutU64(bytes, bytesWritten);
+			bytes.insert(bytes.end(), TRAILER_MAGIC, TRAILER_MAGIC + 4);
+			file.write((const char*)bytes.data(), bytes.size());
+			bytesWritten += bytes.size();
+		}
+
+		void WriterThread() {
+			while (true) {
+				bool stopping = !running; //read before the queue so frames pushed before Close() are never lost
+				Frame* f = queue.Front();
+				if (f == nullptr) {
+					if (stopping) {
+						break;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+
+				//mass, radius and colour are written once per chunk, from its first frame
+				if (chunkFrames > 0 && !chunk[0].SameBodies(*f)) {
+					FlushChunk();
+				}
+				if (chunk.size() <= chunkFrames) {
+					chunk.resize(chunkFrames + 1);
+				}
+				std::swap(chunk[chunkFrames], *f); //keeps both buffers allocated, the slot gets the old storage back
+				chunkFrames++;
+				queue.Pop();
+
+				if (chunkFrames >= framesPerChunk) {
+					FlushChunk();
+				}
+			}
+			FlushChunk();
+			file.flush();
+		}
+
+		static uint16_t Quantize(float v, float min, float scale) {
+			float q = (v - min) * scale;
+			return uint16_t(lroundf(std::min(std::max(q, 0.0f), float(QUANT_MAX))));
+		}
+
+		void FlushChunk() {
+			if (chunkFrames == 0) {
+				return;
+			}
+			uint32_t n = chunk[0].count;
+
+			float minX = 0, minY = 0, maxX = 0, maxY = 0;
+			if (n > 0) {
+				minX = maxX = chunk[0].x[0];
+				minY = maxY = chunk[0].y[0];
+			}
+			for (uint32_t f = 0; f < chunkFrames; f++) {
+				for (uint32_t i = 0; i < n; i++) {
+					minX = std::min(minX, chunk[f].x[i]); maxX = std::max(maxX, chunk[f].x[i]);
+					minY = std::min(minY, chunk[f].y[i]); maxY = std::max(maxY, chunk[f].y[i]);
+				}
+			}
+			float sx = (maxX > minX) ? QUANT_MAX / (maxX - minX) : 0.0f;
+			float sy = (maxY > minY) ? QUANT_MAX / (maxY - minY) : 0.0f;
+
+			out.clear();
+			for (uint32_t i = 0; i < n; i++) {
+				PutVarint(out, uint32_t(chunk[0].radius[i]));
+				PutVarint(out, ZigZag(chunk[0].mass[i]));
+				PutU32(out, chunk[0].color[i]);
+			}
+
+			qPrev.resize(2 * n);
+			qCur.resize(2 * n);
+			uint64_t prevStep = chunk[0].step;
+			for (uint32_t f = 0; f < chunkFrames; f++) {
+				PutVarint(out, chunk[f].step - prevStep);
+				prevStep = chunk[f].step;
+
+				for (uint32_t i = 0; i < n; i++) {
+					qCur[2 * i] = Quantize(chunk[f].x[i], minX, sx);
+					qCur[2 * i + 1] = Quantize(chunk[f].y[i], minY, sy);
+				}
+				if (f == 0) {
+					for (uint32_t i = 0; i < 2 * n; i++) {
+						PutU16(out, qCur[i]);
+					}
+				}
+				else {
+					for (uint32_t i = 0; i < 2 * n; i++) {
+						PutVarint(out, ZigZag(int16_t(uint16_t(qCur[i] - qPrev[i]))));
+					}
+				}
+				std::swap(qPrev, qCur);
+			}
+
+			std::vector<uint8_t> header;
+			header.insert(header.end(), CHUNK_MAGIC, CHUNK_MAGIC + 4);
+			PutU64(header, chunk[0].step);
+			PutU32(header, chunkFrames);
+			PutU32(header, n);
+			PutF32(header, minX); PutF32(header, minY);
+			PutF32(header, maxX); PutF32(header, maxY);
+			PutU32(header, uint32_t(out.size()));
+
+			IndexEntry e;
+			e.offset = bytesWritten;
+			e.firstStep = chunk[0].step;
+			e.lastStep = chunk[chunkFrames - 1].step;
+			e.frameCount = chunkFrames;
+			index.push_back(e);
+
+			file.write((const char*)header.data(), header.size());
+			file.write((const char*)out.data(), out.size());
+			bytesWritten += header.size() + out.size();
+
+			chunkFrames = 0;
+		}
+	};
+}
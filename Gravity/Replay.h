@@ -0,0 +1,398 @@
+#pragma once
+#include "Recorder.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace Trajectory {
+
+	//every frame of one chunk, decoded to floats. positions are stored frame major: x[frame * bodyCount + body]
+	struct DecodedChunk {
+		size_t chunkIndex = 0;
+		uint32_t bodyCount = 0;
+		std::vector<uint64_t> steps;
+		std::vector<float> x, y;
+		std::vector<int> mass, radius;
+		std::vector<uint32_t> color;
+
+		//index of the last frame at or before step
+		uint32_t FrameAt(uint64_t step) const {
+			size_t f = std::upper_bound(steps.begin(), steps.end(), step) - steps.begin();
+			return f == 0 ? 0 : uint32_t(f - 1);
+		}
+
+		void CopyFrame(uint32_t f, Frame &out) const {
+			out.step = steps[f];
+			out.Resize(bodyCount);
+			for (uint32_t i = 0; i < bodyCount; i++) {
+				out.x[i] = x[size_t(f) * bodyCount + i];
+				out.y[i] = y[size_t(f) * bodyCount + i];
+				out.mass[i] = mass[i];
+				out.radius[i] = radius[i];
+				out.color[i] = color[i];
+			}
+		}
+	};
+
+	//Random access reader for files written by Recorder.
+	//Not thread safe, give every thread its own Reader.
+	class Reader {
+	public:
+		bool Open(const std::string &path) {
+			file.close();
+			file.clear();
+			index.clear();
+			file.open(path, std::ios::binary);
+			if (!file.is_open()) {
+				return false;
+			}
+
+			file.seekg(0, std::ios::end);
+			fileSize = uint64_t(file.tellg());
+			if (fileSize < FILE_HEADER_BYTES) {
+				return false;
+			}
+
+			uint8_t header[FILE_HEADER_BYTES];
+			file.seekg(0);
+			file.read((char*)header, FILE_HEADER_BYTES);
+			const uint8_t* p = header + 4;
+			if (memcmp(header, FILE_MAGIC, 4) != 0 || GetU32(p) != VERSION) {
+				return false;
+			}
+
+			if (!ReadIndex()) {
+				RebuildIndex();
+			}
+			return !index.empty();
+		}
+
+		size_t ChunkCount() { return index.size(); }
+		uint64_t FirstStep() { return index.empty() ? 0 : index.front().firstStep; }
+		uint64_t LastStep() { return index.empty() ? 0 : index.back().lastStep; }
+
+		//chunk that contains step, or the closest one before it
+		size_t ChunkFor(uint64_t step) {
+			size_t lo = 0, hi = index.size();
+			while (hi - lo > 1) {
+				size_t mid = (lo + hi) / 2;
+				if (index[mid].firstStep <= step) {
+					lo = mid;
+				}
+				else {
+					hi = mid;
+				}
+			}
+			return lo;
+		}
+
+		//decodes the keyframe and all deltas of one chunk
+		bool DecodeChunk(size_t chunkIndex, DecodedChunk &out) {
+			if (chunkIndex >= index.size()) {
+				return false;
+			}
+			uint8_t header[CHUNK_HEADER_BYTES];
+			file.clear();
+			file.seekg(index[chunkIndex].offset);
+			if (!file.read((char*)header, CHUNK_HEADER_BYTES) || memcmp(header, CHUNK_MAGIC, 4) != 0) {
+				return false;
+			}
+
+			const uint8_t* p = header + 4;
+			uint64_t firstStep = GetU64(p);
+			uint32_t frames = GetU32(p);
+			uint32_t n = GetU32(p);
+			float minX = GetF32(p), minY = GetF32(p);
+			float maxX = GetF32(p), maxY = GetF32(p);
+			uint32_t payloadBytes = GetU32(p);
+
+			//every body takes at least 10 bytes in the keyframe (two varints, colour, position) and 2 in each delta,
+			//every frame at least 1, so counts the payload cannot hold are a damaged file, not an allocation
+			if (payloadBytes > fileSize - index[chunkIndex].offset - CHUNK_HEADER_BYTES || frames == 0 ||
+				uint64_t(n) * 10 > payloadBytes || frames > payloadBytes || (uint64_t(frames) - 1) * 2 * n > payloadBytes) {
+				return false;
+			}
+			payload.resize(payloadBytes);
+			if (!file.read((char*)payload.data(), payloadBytes)) {
+				return false;
+			}
+
+			float sx = (maxX - minX) / QUANT_MAX;
+			float sy = (maxY - minY) / QUANT_MAX;
+
+			out.chunkIndex = chunkIndex;
+			out.bodyCount = n;
+			out.steps.resize(frames);
+			out.x.resize(size_t(frames) * n);
+			out.y.resize(size_t(frames) * n);
+			out.mass.resize(n);
+			out.radius.resize(n);
+			out.color.resize(n);
+
+			const uint8_t* q = payload.data();
+			const uint8_t* end = q + payload.size();
+			for (uint32_t i = 0; i < n; i++) {
+				out.radius[i] = int(GetVarint(q, end));
+				out.mass[i] = UnZigZag(uint32_t(GetVarint(q, end)));
+				if (end - q < 4) {
+					return false;
+				}
+				out.color[i] = GetU32(q);
+			}
+
+			qPrev.resize(2 * n);
+			uint64_t step = firstStep;
+			for (uint32_t f = 0; f < frames; f++) {
+				step += GetVarint(q, end);
+				out.steps[f] = step;
+
+				if (f == 0) {
+					if (size_t(end - q) < 4 * size_t(n)) {
+						return false;
+					}
+					for (uint32_t i = 0; i < 2 * n; i++) {
+						qPrev[i] = GetU16(q);
+					}
+				}
+				else {
+					for (uint32_t i = 0; i < 2 * n; i++) {
+						qPrev[i] = uint16_t(qPrev[i] + UnZigZag(uint32_t(GetVarint(q, end))));
+					}
+				}
+
+				float* fx = &out.x[size_t(f) * n];
+				float* fy = &out.y[size_t(f) * n];
+				for (uint32_t i = 0; i < n; i++) {
+					fx[i] = minX + qPrev[2 * i] * sx;
+					fy[i] = minY + qPrev[2 * i + 1] * sy;
+				}
+			}
+			return q <= end;
+		}
+
+	private:
+		std::ifstream file;
+		uint64_t fileSize = 0;
+		std::vector<IndexEntry> index;
+		std::vector<uint8_t> payload;
+		std::vector<uint16_t> qPrev;
+
+		bool ReadIndex() {
+			if (fileSize < FILE_HEADER_BYTES + TRAILER_BYTES) {
+				return false;
+			}
+			uint8_t trailer[TRAILER_BYTES];
+			file.seekg(fileSize - TRAILER_BYTES);
+			file.read((char*)trailer, TRAILER_BYTES);
+			if (memcmp(trailer + 8, TRAILER_MAGIC, 4) != 0) {
+				return false;
+			}
+			const uint8_t* p = trailer;
+			uint64_t indexOffset = GetU64(p);
+			if (indexOffset + 8 > fileSize - TRAILER_BYTES) {
+				return false;
+			}
+
+			std::vector<uint8_t> bytes(fileSize - TRAILER_BYTES - indexOffset);
+			file.seekg(indexOffset);
+			file.read((char*)bytes.data(), bytes.size());
+			if (memcmp(bytes.data(), INDEX_MAGIC, 4) != 0) {
+				return false;
+			}
+			p = bytes.data() + 4;
+			uint32_t count = GetU32(p);
+			if (bytes.size() < 8 + size_t(count) * 28) {
+				return false;
+			}
+			index.resize(count);
+			for (IndexEntry &e : index) {
+				e.offset = GetU64(p);
+				e.firstStep = GetU64(p);
+				e.lastStep = GetU64(p);
+				e.frameCount = GetU32(p);
+			}
+			return true;
+		}
+
+		//walks the chunk headers of an unterminated file, the last chunk may be cut short and is dropped
+		void RebuildIndex() {
+			index.clear();
+			uint64_t offset = FILE_HEADER_BYTES;
+			uint8_t header[CHUNK_HEADER_BYTES];
+			DecodedChunk scratch;
+			while (offset + CHUNK_HEADER_BYTES <= fileSize) {
+				file.clear();
+				file.seekg(offset);
+				file.read((char*)header, CHUNK_HEADER_BYTES);
+				if (memcmp(header, CHUNK_MAGIC, 4) != 0) {
+					break;
+				}
+				const uint8_t* p = header + 4;
+				IndexEntry e;
+				e.offset = offset;
+				e.firstStep = GetU64(p);
+				e.frameCount = GetU32(p);
+				p = header + CHUNK_HEADER_BYTES - 4;
+				uint64_t next = offset + CHUNK_HEADER_BYTES + GetU32(p);
+				if (next > fileSize) {
+					break;
+				}
+
+				//the last step is only in the payload
+				index.push_back(e);
+				if (!DecodeChunk(index.size() - 1, scratch)) {
+					index.pop_back();
+					break;
+				}
+				index.back().lastStep = scratch.steps.back();
+				offset = next;
+			}
+		}
+	};
+
+	//Serves frames for scrubbing. Chunks around the last requested one are decoded
+	//ahead of time on a worker thread, a miss is decoded on the calling thread.
+	class Player {
+	public:
+		~Player() {
+			Close();
+		}
+
+		bool Open(const std::string &path) {
+			Close();
+			if (!reader.Open(path) || !prefetchReader.Open(path)) {
+				return false;
+			}
+			stopping = false;
+			wanted.clear();
+			worker = std::thread(&Player::PrefetchThread, this);
+			return true;
+		}
+
+		void Close() {
+			if (worker.joinable()) {
+				{
+					std::lock_guard<std::mutex> lock(mtx);
+					stopping = true;
+				}
+				cv.notify_one();
+				worker.join();
+			}
+			cache.clear();
+		}
+
+		uint64_t FirstStep() { return reader.FirstStep(); }
+		uint64_t LastStep() { return reader.LastStep(); }
+
+		//fills out with the last recorded frame at or before step
+		bool Seek(uint64_t step, Frame &out) {
+			if (reader.ChunkCount() == 0) {
+				return false;
+			}
+			size_t c = reader.ChunkFor(step);
+			std::shared_ptr<const DecodedChunk> chunk = Lookup(c);
+			if (!chunk) {
+				std::shared_ptr<DecodedChunk> decoded = std::make_shared<DecodedChunk>();
+				if (!reader.DecodeChunk(c, *decoded)) {
+					return false;
+				}
+				Insert(decoded);
+				chunk = decoded;
+			}
+			chunk->CopyFrame(chunk->FrameAt(step), out);
+
+			//read ahead in the direction the user is scrubbing, and keep one chunk behind
+			int dir = (c >= lastChunk) ? 1 : -1;
+			lastChunk = c;
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				wanted.clear();
+				for (int k = 1; k <= PREFETCH_CHUNKS; k++) {
+					long long ahead = (long long)c + dir * k;
+					if (ahead >= 0 && ahead < (long long)reader.ChunkCount()) {
+						wanted.push_back(size_t(ahead));
+					}
+				}
+				if (c >= 1 && dir > 0) {
+					wanted.push_back(c - 1);
+				}
+				else if (dir < 0 && c + 1 < reader.ChunkCount()) {
+					wanted.push_back(c + 1);
+				}
+			}
+			cv.notify_one();
+			return true;
+		}
+
+	private:
+		static const int PREFETCH_CHUNKS = 3;
+		static const size_t CACHE_CHUNKS = 8;
+
+		Reader reader, prefetchReader;
+		std::thread worker;
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool stopping = false;
+		std::vector<size_t> wanted;
+		std::vector<std::shared_ptr<const DecodedChunk>> cache; //most recently used at the back
+		size_t lastChunk = 0;
+
+		std::shared_ptr<const DecodedChunk> Lookup(size_t c) {
+			std::lock_guard<std::mutex> lock(mtx);
+			for (size_t i = 0; i < cache.size(); i++) {
+				if (cache[i]->chunkIndex == c) {
+					std::shared_ptr<const DecodedChunk> hit = cache[i];
+					cache.erase(cache.begin() + i);
+					cache.push_back(hit);
+					return hit;
+				}
+			}
+			return nullptr;
+		}
+
+		void Insert(std::shared_ptr<const DecodedChunk> chunk) {
+			std::lock_guard<std::mutex> lock(mtx);
+			for (auto &cached : cache) {
+				if (cached->chunkIndex == chunk->chunkIndex) {
+					return;
+				}
+			}
+			if (cache.size() >= CACHE_CHUNKS) {
+				cache.erase(cache.begin());
+			}
+			cache.push_back(chunk);
+		}
+
+		bool Cached(size_t c) {
+			for (auto &cached : cache) {
+				if (cached->chunkIndex == c) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void PrefetchThread() {
+			while (true) {
+				size_t c = 0;
+				{
+					std::unique_lock<std::mutex> lock(mtx);
+					cv.wait(lock, [this] { return stopping || !wanted.empty(); });
+					if (stopping) {
+						return;
+					}
+					c = wanted.front();
+					wanted.erase(wanted.begin());
+					if (Cached(c)) {
+						continue;
+					}
+				}
+
+				std::shared_ptr<DecodedChunk> decoded = std::make_shared<DecodedChunk>();
+				if (prefetchReader.DecodeChunk(c, *decoded)) {
+					Insert(decoded);
+				}
+			}
+		}
+	};
+}
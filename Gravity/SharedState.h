@@ -0,0 +1,349 @@
+#pragma once
+#include "Physics.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//Publishes every completed step into a POSIX shared memory ring so other processes can watch a run.
+//The segment is a header and a few slots, each slot one frame in columns (x, y, vx, vy, mass, radius, color)
+//guarded by a seqlock: the publisher makes the sequence odd, writes, and makes it even again.
+//Readers look at the newest slot in place and check the sequence afterwards, a reader that was overtaken
+//simply tries again with the newer frame. The publisher never waits for or even knows about readers.
+//
+//When a frame no longer fits, the publisher marks the segment stale and recreates it, twice as large,
+//under the same name. Readers that see the stale flag reopen by name.
+namespace SharedState {
+
+	const uint32_t MAGIC = 0x53443247; //"G2DS"
+	const uint32_t VERSION = 1;
+	const int DEFAULT_SLOTS = 4;
+
+	struct Header {
+		uint32_t magic, version;
+		uint32_t slots, capacity; //bodies per slot
+		uint64_t slotBytes;
+		std::atomic<uint64_t> published; //frames so far, the newest is in slot (published - 1) % slots
+		std::atomic<uint32_t> stale; //set when the publisher moved to a new segment
+	};
+
+	struct SlotHeader {
+		std::atomic<uint64_t> sequence; //odd while being written
+		uint64_t step;
+		double time;
+		uint32_t count;
+	};
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "the seqlock is shared between processes");
+
+	inline size_t RoundUp(size_t bytes) {
+		return (bytes + 63) & ~size_t(63);
+	}
+
+	//byte offsets inside a slot, the header first, then every column cache line aligned
+	struct Layout {
+		size_t x, y, vx, vy, mass, radius, color, bytes;
+
+		explicit Layout(uint32_t capacity) {
+			size_t column = RoundUp(size_t(capacity) * 4);
+			x = RoundUp(sizeof(SlotHeader));
+			y = x + column;
+			vx = y + column;
+			vy = vx + column;
+			mass = vy + column;
+			radius = mass + column;
+			color = radius + column;
+			bytes = color + column;
+		}
+	};
+
+	//a frame in shared memory, the pointers stay readable until the reader closes but the contents can be
+	//overwritten at any time, so only trust what was read before Reader::Valid() returned true
+	struct View {
+		uint64_t sequence = 0;
+		uint64_t step = 0;
+		double time = 0;
+		uint32_t count = 0;
+		const float *x = nullptr, *y = nullptr, *vx = nullptr, *vy = nullptr;
+		const int32_t *mass = nullptr, *radius = nullptr;
+		const uint32_t *color = nullptr;
+		const SlotHeader* slot = nullptr;
+	};
+
+	//maps a segment, shared by the publisher and the reader
+	class Segment {
+	public:
+		Segment() = default;
+		Segment(const Segment&) = delete; //owns the mapping
+		Segment& operator=(const Segment&) = delete;
+
+		~Segment() {
+			Unmap();
+		}
+
+		Header* header = nullptr;
+
+		char* Slot(uint32_t index) {
+			return base + RoundUp(sizeof(Header)) + size_t(index) * header->slotBytes;
+		}
+
+	protected:
+		char* base = nullptr;
+		size_t bytes = 0;
+
+		static std::string ShmName(const std::string &name) {
+			return name.empty() || name[0] == '/' ? name : "/" + name;
+		}
+
+		void Unmap() {
+#if defined(__linux__)
+			if (base != nullptr) {
+				munmap(base, bytes);
+			}
+#endif
+			base = nullptr;
+			header = nullptr;
+			bytes = 0;
+		}
+	};
+
+	class Publisher : public Segment {
+	public:
+		~Publisher() {
+			Close();
+		}
+
+		//creates the segment, replacing any left over from an earlier run with the same name
+		bool Open(const std::string &segmentName, uint32_t capacity = 1024, uint32_t slots = DEFAULT_SLOTS) {
+			Close();
+			name = ShmName(segmentName);
+			return Create(capacity < 1 ? 1 : capacity, slots < 2 ? 2 : slots);
+		}
+
+		//removes the name, readers that still have the segment mapped keep their last frames
+		void Close() {
+#if defined(__linux__)
+			if (header != nullptr) {
+				header->stale.store(1, std::memory_order_release);
+				shm_unlink(name.c_str());
+			}
+#endif
+			Unmap();
+		}
+
+		bool IsOpen() {
+			return header != nullptr;
+		}
+
+		//copies the bodies into the next slot, never blocks. false if a bigger segment could not be made
+		bool Publish(const std::vector<Body2D> &b, uint64_t step, double time) {
+			if (header == nullptr) {
+				return false;
+			}
+			if (b.size() > header->capacity) {
+				uint32_t slots = header->slots;
+				uint32_t capacity = header->capacity;
+				while (capacity < b.size()) {
+					capacity *= 2;
+				}
+				header->stale.store(1, std::memory_order_release);
+#if defined(__linux__)
+				shm_unlink(name.c_str());
+#endif
+				Unmap();
+				if (!Create(capacity, slots)) {
+					return false;
+				}
+			}
+
+			uint64_t frame = header->published.load(std::memory_order_relaxed);
+			char* slotBase = Slot(uint32_t(frame % header->slots));
+			SlotHeader* slot = (SlotHeader*)slotBase;
+			Layout layout(header->capacity);
+
+			uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+			slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			float* x = (float*)(slotBase + layout.x);
+			float* y = (float*)(slotBase + layout.y);
+			float* vx = (float*)(slotBase + layout.vx);
+			float* vy = (float*)(slotBase + layout.vy);
+			int32_t* mass = (int32_t*)(slotBase + layout.mass);
+			int32_t* radius = (int32_t*)(slotBase + layout.radius);
+			uint32_t* color = (uint32_t*)(slotBase + layout.color);
+			int len = b.size();
+			for (int counter = 0; counter < len; counter++) {
+				x[counter] = b[counter].pos.x;
+				y[counter] = b[counter].pos.y;
+				vx[counter] = b[counter].vel.x;
+				vy[counter] = b[counter].vel.y;
+				mass[counter] = b[counter].mass;
+				radius[counter] = b[counter].radius;
+				color[counter] = b[counter].color;
+			}
+			slot->step = step;
+			slot->time = time;
+			slot->count = uint32_t(len);
+
+			slot->sequence.store(sequence + 2, std::memory_order_release);
+			header->published.store(frame + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		std::string name;
+
+		bool Create(uint32_t capacity, uint32_t slots) {
+#if defined(__linux__)
+			Layout layout(capacity);
+			bytes = RoundUp(sizeof(Header)) + size_t(slots) * layout.bytes;
+
+			shm_unlink(name.c_str());
+			int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+			if (fd < 0) {
+				return false;
+			}
+			if (ftruncate(fd, bytes) != 0) {
+				close(fd);
+				shm_unlink(name.c_str());
+				return false;
+			}
+			void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			close(fd);
+			if (p == MAP_FAILED) {
+				shm_unlink(name.c_str());
+				return false;
+			}
+
+			//ftruncate zero fills, so every sequence starts even and published at 0
+			base = (char*)p;
+			header = (Header*)base;
+			header->version = VERSION;
+			header->slots = slots;
+			header->capacity = capacity;
+			header->slotBytes = layout.bytes;
+			std::atomic_thread_fence(std::memory_order_release);
+			header->magic = MAGIC; //last, readers that map early see no magic and retry
+			return true;
+#else
+			(void)capacity;
+			(void)slots;
+			return false;
+#endif
+		}
+	};
+
+	class Reader : public Segment {
+	public:
+		//a failed open leaves the segment that was mapped before, if any, in place
+		bool Open(const std::string &segmentName) {
+			name = ShmName(segmentName);
+#if defined(__linux__)
+			int fd = shm_open(name.c_str(), O_RDONLY, 0);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat st;
+			if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+				close(fd);
+				return false;
+			}
+			void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			close(fd);
+			if (p == MAP_FAILED) {
+				return false;
+			}
+			Header* h = (Header*)p;
+			if (h->magic != MAGIC || h->version != VERSION || RoundUp(sizeof(Header)) + size_t(h->slots) * h->slotBytes > size_t(st.st_size)) {
+				munmap(p, st.st_size);
+				return false;
+			}
+			Unmap();
+			base = (char*)p;
+			bytes = st.st_size;
+			header = h;
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		void Close() {
+			Unmap();
+		}
+
+		bool IsOpen() {
+			return header != nullptr;
+		}
+
+		//points view at the newest complete frame. false when there is none yet or the publisher is
+		//writing over it right now, in which case the caller tries again later
+		bool Latest(View &view) {
+			//after the publisher is gone the old segment still holds its last frames
+			if ((header == nullptr || header->stale.load(std::memory_order_acquire)) && !Open(name) && header == nullptr) {
+				return false;
+			}
+			uint64_t frames = header->published.load(std::memory_order_acquire);
+			if (frames == 0) {
+				return false;
+			}
+			char* slotBase = Slot(uint32_t((frames - 1) % header->slots));
+			const SlotHeader* slot = (const SlotHeader*)slotBase;
+			view.sequence = slot->sequence.load(std::memory_order_acquire);
+			if (view.sequence & 1) {
+				return false;
+			}
+
+			Layout layout(header->capacity);
+			view.slot = slot;
+			view.step = slot->step;
+			view.time = slot->time;
+			view.count = slot->count < header->capacity ? slot->count : header->capacity;
+			view.x = (const float*)(slotBase + layout.x);
+			view.y = (const float*)(slotBase + layout.y);
+			view.vx = (const float*)(slotBase + layout.vx);
+			view.vy = (const float*)(slotBase + layout.vy);
+			view.mass = (const int32_t*)(slotBase + layout.mass);
+			view.radius = (const int32_t*)(slotBase + layout.radius);
+			view.color = (const uint32_t*)(slotBase + layout.color);
+			return true;
+		}
+
+		//true if nothing in view was overwritten since Latest() returned it
+		bool Valid(const View &view) {
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return view.slot != nullptr && view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+		}
+
+		//the newest frame copied into b, retrying while the publisher laps us. vel is published, acc is not
+		bool Read(std::vector<Body2D> &b, uint64_t &step) {
+			for (int attempt = 0; attempt < 8; attempt++) {
+				View view;
+				if (!Latest(view)) {
+					continue;
+				}
+				b.resize(view.count);
+				for (uint32_t counter = 0; counter < view.count; counter++) {
+					b[counter] = Body2D(view.x[counter], view.y[counter], view.vx[counter], view.vy[counter], 0, 0,
+						view.mass[counter], view.radius[counter], view.color[counter]);
+				}
+				if (Valid(view)) {
+					step = view.step;
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		std::string name;
+	};
+}
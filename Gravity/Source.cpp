@@ -1,5 +1,17 @@
 #define OLC_PGE_APPLICATION
+#define ALLOC_TRACKER_APPLICATION
 #include "olcPixelGameEngine.h"
+#include "Physics.h"
+#include "Capture.h"
+#include "Recorder.h"
+#include "Replay.h"
+#include "SharedState.h"
+#include "Stream.h"
+#include "Profiler.h"
+#include "Raster.h"
+#include "SpatialIndex.h"
+#include "Telemetry.h"
+#include "Trails.h"
 #include <cmath>
 #include <map>
 #include <string>
@@ -13,7 +25,9 @@ class UI {
 public:
 	//InputMapping
 	enum InputAction {
-		ZOOMIN, ZOOMOUT, PAUSEMENU, PAUSESIM, EXIT, ADDBODY, DELETEBODY, ADDMASS, TOGGLEVECTORS, TOGGLECENTER
+		ZOOMIN, ZOOMOUT, PAUSEMENU, PAUSESIM, EXIT, ADDBODY, DELETEBODY, ADDMASS, TOGGLEVECTORS, TOGGLECENTER, RECORD,
+		REPLAYFORWARD, REPLAYBACK, REPLAYFASTER, REPLAYSLOWER, TOGGLEPROFILER, TRACECAPTURE, TOGGLECOUNTERS, TOGGLEDECALS,
+		TOGGLECAPTURE, TOGGLETRAILS
 	};
 
 	std::map<InputAction, olc::Key> inputMap;
@@ -30,6 +44,17 @@ public:
 		inputMap[TOGGLEVECTORS] = olc::V;
 		inputMap[ADDMASS] = olc::A;
 		inputMap[TOGGLECENTER] = olc::C;
+		inputMap[RECORD] = olc::R;
+		inputMap[REPLAYFORWARD] = olc::RIGHT;
+		inputMap[REPLAYBACK] = olc::LEFT;
+		inputMap[REPLAYFASTER] = olc::UP;
+		inputMap[REPLAYSLOWER] = olc::DOWN;
+		inputMap[TOGGLEPROFILER] = olc::P;
+		inputMap[TRACECAPTURE] = olc::T;
+		inputMap[TOGGLECOUNTERS] = olc::H;
+		inputMap[TOGGLEDECALS] = olc::B;
+		inputMap[TOGGLECAPTURE] = olc::M;
+		inputMap[TOGGLETRAILS] = olc::O;
 	}
 
 	//save controls function
@@ -38,292 +63,6 @@ public:
 };
 
 
-class Vec2D {
-public:
-	float x, y;
-
-	Vec2D(float xPos = 0.0f, float yPos = 0.0f) {
-		x = xPos;
-		y = yPos;
-	}
-
-	//returns the magnitude of the vector compared to 0, 0
-	float mag() {
-		return sqrtf(x*x + y*y);
-	}
-
-	//returns distance between this vector and vector passed in.
-	float dist(Vec2D v2) {
-		return sqrtf(VectorDistanceSquared(*this, v2));
-	}
-
-	//angle in radians, use sinAngleBetween, cosAngleBetween, for more efficiency (I think).
-	float angleBetween(Vec2D v2) {
-		return atan2f((v2.x - this->x), (v2.y - this->y));
-	}
-
-	float sinAngleBetween(Vec2D v2) {
-		//opposite over hypoteneuse
-		return -1*((v2.y - this->y) / sqrtf(VectorDistanceSquared(*this, v2)));
-	}
-
-	float cosAngleBetween(Vec2D v2) {
-		//adjacent over hypoteneuse
-		return ((v2.x - this->x) / sqrtf(VectorDistanceSquared(*this, v2)));
-	}
-
-	float tanAngleBetween(Vec2D v2) {
-		return (this->sinAngleBetween(v2) / this->cosAngleBetween(v2));
-	}
-
-	void normalize() {
-
-		float mag = this->mag();
-
-		this->x /= mag;
-		this->y /= mag;
-	}
-
-	//multiplies vector by a scalar
-	void scale(float sFactor) {
-		this->x *= sFactor;
-		this->y *= sFactor;
-	}
-
-	//returns square of magnitude of the vector
-	float magSquared() {
-		return ((this->x * this->x) + (this->y * this->y));
-	}
-
-	//clamps magnitude of vec between min and max
-	void clamp(float min, float max) {
-		if (this->magSquared() < (min*min)) {
-			this->normalize();
-			this->scale(min);
-		}
-		else if (this->magSquared() > (max*max)) {
-			this->normalize();
-			this->scale(max);
-		}
-			
-	}
-
-	//Static functions
-	//adds two vectors using vector addition
-	static Vec2D VectorAdd(Vec2D v1, Vec2D v2) {
-		return Vec2D(v1.x + v2.x, v1.y + v2.y);
-	}
-
-	//returns distance between two vectors squared
-	static float VectorDistanceSquared(Vec2D v1, Vec2D v2) {
-		return ((v2.x - v1.x) * (v2.x - v1.x) + (v2.y - v1.y) * (v2.y - v1.y));
-	}
-};
-
-class Body2D {
-public:
-
-	static const int METERS_TO_PIXELS = 500000000; //number of square meters per pixel
-	static const int STAR_ENLARGEMENT_FACTOR = 10; //multiply star radius by this number to make star visible
-	static const int PLANET_ENLARGEMENT_FACTOR = 20; // same as above but for planets
-
-	//static const int numBodies = 9;
-	
-
-	//Vector velocity
-	//acceleration
-	//position
-	//radius
-	//light source?
-	bool active;
-	int mass, radius;
-	Vec2D pos, vel, acc;
-	olc::Pixel color;
-
-	Vec2D velDrawArrowEnd;
-
-	bool toggleAsCenter = false;
-
-	Body2D(float xPos, float yPos, float xVel, float yVel, float xAcc, float yAcc, int m, int r, olc::Pixel colorPixel) {
-		pos = Vec2D(xPos, yPos);
-		vel = Vec2D(xVel, yVel);
-		acc = Vec2D(xAcc, yAcc);
-		mass = m;
-		radius = r;
-		active = true;
-		color = colorPixel;
-	}
-
-	Body2D() = default;
-
-	void UpdateVel(float fElapsedTime) {
-		if (this->active) {
-			this->vel.x += (this->acc.x * fElapsedTime);
-			this->vel.y += (this->acc.y * fElapsedTime);
-		}
-	}
-
-	void UpdatePos(float fElapsedTime) {
-		if (this->active) {
-			this->pos.x += (this->vel.x * fElapsedTime);
-			this->pos.y -= (this->vel.y * fElapsedTime);
-		}
-	}
-
-
-	//STATIC FUNCTIONS
-
-	static void UpdateVelandPos(std::vector<Body2D> &b, float fElapsedTime) {
-		int len = b.size();
-
-		for (int counter = 0; counter < len; counter++) {
-			b[counter].UpdateVel(fElapsedTime);
-			b[counter].UpdatePos(fElapsedTime);
-		}
-	}
-
-	static void InitBodies(std::vector<Body2D> &b) {
-		//sun, earth, moon
-		b.push_back(Body2D(750, 400, 0, 150, 0, 0, 1, 9, olc::BLUE));
-		b.push_back(Body2D(400, 400, 0, 0, 0, 0, 100, 35, olc::YELLOW));
-		b.push_back(Body2D(790, 400, 0, 100, 0, 0, .01, 3, olc::GREY));
-		
-		/*
-		b.push_back(Body2D(750 + 1000, 400, 0, 150, 0, 0, 1, 9, olc::BLUE));
-		b.push_back(Body2D(400 + 1000, 400, 0, 0, 0, 0, 100, 35, olc::YELLOW));
-		b.push_back(Body2D(790 + 1000, 400, 0, 100, 0, 0, .01, 3, olc::GREY));
-
-		b.push_back(Body2D(750 - 1000, 400, 0, 150, 0, 0, 1, 9, olc::BLUE));
-		b.push_back(Body2D(400 - 1000, 400, 0, 0, 0, 0, 100, 35, olc::YELLOW));
-		b.push_back(Body2D(790 - 1000, 400, 0, 100, 0, 0, .01, 3, olc::GREY));
-
-		*/
-
-		/*
-		//collision
-		b[0] = Body2D(600, 600, -160, 200, 0, 0, 1, 30, olc::BLUE);
-		b[1] = Body2D(400, 400, 50, 0, 0, 0, 10, 30, olc::YELLOW);
-		*/
-
-		//b[0] = Body2D(100, 120, 200, 0, 0, 0, 10, 10, olc::DARK_RED);
-		//b[1] = Body2D(400, 400, 0, 0, 0, 0, 100, 10, olc::GREEN);
-		//b[3] = Body2D(400, 1800, 100, 100, 0, 0, 3, 15, olc::YELLOW);
-	}
-
-	//Updates gravity on all the objects, and resolves collisions
-	static void UpdateGravity(std::vector<Body2D> &b) {
-		
-		int len = b.size();
-
-		for (int counter = 0; counter < len; counter++) {
-			b[counter].acc.x = 0;
-			b[counter].acc.y = 0;
-		}
-		//float distMatrix[len][len] = { {0} };
-		for (int out = 0; out < len; out++) {
-			for (int in = 0; in < len; in++) {
-				if (in != out && b[in].active && b[out].active) {
-					float rSquared = Vec2D::VectorDistanceSquared(b[in].pos, b[out].pos);
-					//distMatrix[in][out] = rSquared;
-					//distMatrix[out][in] = rSquared;
-
-					float gravity = 0.0;
-					if (rSquared != 0) {
-						gravity = 100000 * (b[in].mass / rSquared);
-					}
-					b[out].acc.x += gravity * b[out].pos.cosAngleBetween(b[in].pos);
-					b[out].acc.y += gravity * b[out].pos.sinAngleBetween(b[in].pos);
-
-					//resolve collisions
-					float radius1 = b[in].radius / 2;
-					float radius2 = b[out].radius / 2;
-					float minDist = radius1 + radius2;
-					if (rSquared < minDist*minDist) {
-						ResolveCollision(b, in, out);
-					}
-				}
-				if (!b[in].active) {
-					Body2D temp = b[b.size() - 1];
-					b[b.size() - 1] = b[in];
-					b[in] = temp;
-					b.resize(b.size() - 1);
-					len = b.size();
-				}
-			}
-
-			if (!b[out].active) {
-				Body2D temp = b[b.size() - 1];
-				b[b.size() - 1] = b[out];
-				b[out] = temp;
-				b.resize(b.size() - 1);
-				len = b.size();
-			}
-		}
-	}
-
-	static void ResolveCollision(std::vector<Body2D> &b,int i1, int i2) {
-		int index = 0;
-		int toBeDeactivated = 0;
-		if (b[i1].mass > b[i2].mass) {
-			toBeDeactivated = i2;
-			index = i1;
-		}
-		else {
-			toBeDeactivated = i1;
-			index = i2;
-		}
-
-		//set velocties to conserve momentum
-		b[index].vel.x = ((b[i1].mass * b[i1].vel.x) + (b[i2].mass * b[i2].vel.x)) / (b[i1].mass + b[i2].mass);
-		b[index].vel.y = ((b[i1].mass * b[i1].vel.y) + (b[i2].mass * b[i2].vel.y)) / (b[i1].mass + b[i2].mass);
-		
-
-		//set radius of new planet/star
-		b[index].radius = sqrt((b[index].radius * b[index].radius) + (b[toBeDeactivated].radius * b[toBeDeactivated].radius));
-
-		//set mass to sum and deactivate other planet.
-		b[index].mass += b[toBeDeactivated].mass;
-		b[toBeDeactivated].active = false;
-	}
-
-	static void AddBodyAt(std::vector<Body2D> &b, Vec2D pos) {
-		b.push_back(Body2D(pos.x, pos.y, 0, 0, 0, 0, 1, 10, olc::GREEN));
-		//UpdateGravity(b);
-	}
-
-	static void DeleteBodyAt(std::vector<Body2D> &b, Vec2D mousePos) {
-		for (int counter = 0; counter < b.size(); counter++) {
-			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
-				b[counter].active = false;
-
-				Body2D temp = b[b.size() - 1];
-				b[b.size() - 1] = b[counter];
-				b[counter] = temp;
-				b.resize(b.size() - 1);
-			}
-		}
-	}
-
-	static void AddMassAt(std::vector<Body2D> &b, Vec2D mousePos) {
-		for (int counter = 0; counter < b.size(); counter++) {
-			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
-				b[counter].mass += 10;
-			}
-		}
-	}
-
-	static void ToggleCenterPlanet(std::vector<Body2D> &b, Vec2D mousePos) {
-		for (int counter = 0; counter < b.size(); counter++) {
-			if (Vec2D::VectorDistanceSquared(mousePos, b[counter].pos) < (b[counter].radius * b[counter].radius)) {
-				b[counter].toggleAsCenter = !b[counter].toggleAsCenter;
-			}
-			else {
-				b[counter].toggleAsCenter = false;
-			}
-		}
-	}
-};
-
 class Graphics : public olc::PixelGameEngine
 {
 public:
@@ -376,22 +115,167 @@ public:
 	olc::Sprite* pausedSprite = nullptr;
 	olc::Decal* pausedDecal = nullptr;
 
+	//B draws bodies as tinted decals from the atlas on their own layer under layer 0, instead of pixel circles
+	bool drawDecals = false;
+	Raster::CircleAtlas atlas;
+	uint8_t bodyLayer = 0;
+
+	//only bodies near the screen are drawn. bodiesVersion changes whenever b does. building the index costs a few
+	//linear passes, so bodies that change every frame are culled with one linear pass and the index is only built
+	//once they hold still for a frame: paused with nothing being edited, between the frames of a slower stream, a
+	//replay that is not playing
+	SpatialIndex bodyIndex;
+	uint64_t bodiesVersion = 1, indexedVersion = 0, lastFrameVersion = 0;
+	const float ARROWHEAD_REACH = 20; //world units an arrowhead can stick out past the end of its vector
+	std::vector<int> visible;
+	Raster::Arrows arrows; //velocity and acceleration overlay
+	Raster::TiledCircles circles; //pixel circles of the visible bodies, drawn by screen tile on physicsThreads
+	int centerIndex = -1; //body the camera follows, -1 for none
+
+	//with more bodies on screen than can be told apart, the small ones are drawn as a density map instead.
+	//on above DENSITY_BODIES visible bodies under DENSITY_RADIUS pixels on average, off again a fifth below that
+	Raster::DensitySplat density;
+	bool densityView = false;
+	std::vector<int> splatted;
+
+	//O draws where every body has been, out of a fixed budget of points shared by all of them. recorded once per
+	//change of the bodies, however many steps that was
+	Trails trails;
+	bool showTrails = false;
+	uint64_t trailsVersion = 0;
+	std::vector<int> removedRows; //bodies merged or deleted this frame, the trails follow the rows that moved
+	const float TRAIL_TOLERANCE = 0.5f; //pixels a trail may stray from the path
+	const int DENSITY_BODIES = 20000;
+	const float DENSITY_RADIUS = 1.5f;
+	const float SPLAT_RADIUS = 2; //bodies at least this many pixels across are still drawn as circles
+
+	//trajectory recording, frames are handed to a background writer thread
+	Trajectory::Recorder recorder;
+	std::string recordPath = "trajectory.g2dt";
+	uint64_t stepCount = 0; //number of physics steps taken
+	int physicsThreads = std::max(1u, std::thread::hardware_concurrency());
+	//M captures the rendered frames to capturePath, a .y4m video or a png sequence, encoded on background threads
+	Capture::Exporter capture;
+	Capture::Options captureOptions;
+	std::string capturePath = "capture.y4m";
+	bool capturing = false; //the exporter opens with the first frame, once its size is known
+
+	int frameLimit = 0, framesDrawn = 0; //quits after frameLimit frames when it is set, the offscreen build has no keyboard
+
+	//one record per simulated frame, written by the telemetry thread to telemetryPath or the console when empty
+	Telemetry telemetry;
+	std::string telemetryPath;
+	TelemetryRecord frameRecord;
+
+	//replay mode, bodies come from a recorded trajectory instead of the physics
+	bool replaying = false;
+	std::string replayPath;
+	Trajectory::Player player;
+	Trajectory::Frame replayFrame;
+	double replayStep = 0; //current position in the recording, in steps
+	float replaySpeed = 60; //recorded steps played per second
+	const int TIMELINE_HEIGHT = 12;
+
+	//shared memory, publishName publishes every step for other processes, attachName shows another process's run
+	SharedState::Publisher publisher;
+	std::string publishName;
+	SharedState::Reader attached;
+	std::string attachName;
+	uint64_t attachedStep = 0;
+
+	//network, servePort streams the run to remote viewers, connectHost shows a run streamed that way
+	Stream::Server server;
+	int servePort = 0;
+	float serveRate = 30; //frames per second sent to them
+	Stream::Client remote;
+	std::string connectHost;
+	int connectPort = 0;
+	uint64_t remoteStep = 0;
+
+	//frame profiler, P shows the graph, T starts and stops a chrome trace capture, H adds hardware counters to the overlay
+	Profiler profiler;
+	bool showProfiler = false;
+	std::string tracePath = "trace.json";
+	int cameraPhase = profiler.AddPhase("PanCamera/ZoomCamera");
+	int editPhase = profiler.AddPhase("EditObjects");
+	int gravityPhase = profiler.AddPhase("UpdateGravity");
+	int integratePhase = profiler.AddPhase("UpdateVelandPos");
+	int replayPhase = profiler.AddPhase("UpdateReplay");
+	int attachPhase = profiler.AddPhase("ReadShared");
+	int remotePhase = profiler.AddPhase("ReadStream");
+	int cullPhase = profiler.AddPhase("CullIndex");
+	int trailsPhase = profiler.AddPhase("RecordTrails/DrawTrails");
+	int drawBodiesPhase = profiler.AddPhase("DrawBodies");
+	int drawVectorsPhase = profiler.AddPhase("DrawBodyVelAndAccVectors");
+	int overlayPhase = profiler.AddPhase("ProfilerOverlay");
+	int uploadPhase = profiler.AddPhase("LayerUpload");
+	int decalPhase = profiler.AddPhase("DecalSubmit");
+	int capturePhase = profiler.AddPhase("CaptureFrame");
+
 
 
 
 	bool OnUserCreate() override
 	{
 		// Called once at the start, so create things here
-		Body2D::InitBodies(b);
+		profiler.AttachThread(); //olc calls this and OnUserUpdate on its engine thread, not the one that built Graphics
+		if (!replayPath.empty()) {
+			replaying = player.Open(replayPath);
+			if (!replaying) {
+				std::cout << "could not open replay " << replayPath << "\n";
+			}
+			replayStep = player.FirstStep();
+			toggleVectors = false; //vel and acc are not recorded
+		}
+		if (!replaying) {
+			Body2D::InitBodies(b);
+		}
+		if (!attachName.empty()) {
+			toggleVectors = false; //acc is not published
+		}
+		if (!publishName.empty() && !publisher.Open(publishName)) {
+			std::cout << "could not create shared memory segment " << publishName << "\n";
+		}
+		if (!connectHost.empty()) {
+			toggleVectors = false; //only positions are streamed
+			if (!remote.Connect(connectHost, connectPort)) {
+				std::cout << "could not connect to " << connectHost << ":" << connectPort << "\n";
+			}
+		}
+		if (servePort > 0 && !server.Open(servePort, serveRate)) {
+			std::cout << "could not listen on port " << servePort << "\n";
+		}
+
+		if (!telemetry.Open(telemetryPath)) {
+			std::cout << "could not open telemetry file " << telemetryPath << "\n";
+		}
 
 		pausedSprite = new olc::Sprite("../Assets/paused.png");
 		pausedDecal = new olc::Decal(pausedSprite);
 
+		//same as the engine's own layer drawing, wrapped so the texture upload shows up in the profiler
+		SetLayerCustomRenderFunction(0, [this]() { DrawLayer(GetLayers()[0]); });
+
+		//the body layer never changes its sprite, it is only there for the decals
+		atlas.Build();
+		bodyLayer = uint8_t(CreateLayer());
+		EnableLayer(bodyLayer, true);
+		SetLayerCustomRenderFunction(bodyLayer, [this]() { DrawDecalLayer(GetLayers()[bodyLayer]); });
+
+		olc::renderer->KeepFrames(capturing);
 		return true;
 	}
 
 	bool OnUserUpdate(float fElapsedTime) override
 	{
+		//the previous frame ends here, including its texture upload
+		profiler.NextFrame();
+		profiler.SetBodies(int(b.size()));
+		if (capturing) {
+			Profiler::Scope scope(profiler, capturePhase);
+			CaptureFrame();
+		}
+
 		//pause
 		if (GetKey(IO.inputMap[UI::PAUSESIM]).bPressed) {
 			pause = !pause;
@@ -401,115 +285,659 @@ public:
 			toggleVectors = !toggleVectors;
 		}
 
-		// called once per frame
-		Clear(olc::Pixel(0, 0, 0));
+		if (GetKey(IO.inputMap[UI::RECORD]).bPressed) {
+			ToggleRecording();
+		}
+
+		if (GetKey(IO.inputMap[UI::TOGGLEPROFILER]).bPressed) {
+			showProfiler = !showProfiler;
+		}
+
+		if (GetKey(IO.inputMap[UI::TRACECAPTURE]).bPressed) {
+			ToggleTraceCapture();
+		}
+
+		if (GetKey(IO.inputMap[UI::TOGGLECAPTURE]).bPressed) {
+			ToggleCapture();
+		}
+		if (GetKey(IO.inputMap[UI::TOGGLEDECALS]).bPressed) {
+			drawDecals = !drawDecals;
+		}
+		if (GetKey(IO.inputMap[UI::TOGGLETRAILS]).bPressed) {
+			showTrails = !showTrails;
+			trails.Clear(); //they would join up across the time they were off
+		}
+
+		if (GetKey(IO.inputMap[UI::TOGGLECOUNTERS]).bPressed) {
+			bool on = !profiler.CountersEnabled();
+			if (profiler.EnableCounters(on) != on) {
+				std::cout << "hardware counters not available\n";
+			}
+		}
+
+		// called once per frame, see through to the body layer when bodies are decals
+		Clear(drawDecals ? olc::BLANK : olc::Pixel(0, 0, 0));
 		time += fElapsedTime;
 
 		
 		//pan and zoom camera
-		PanCamera(fElapsedTime);
-		ZoomCamera(fElapsedTime);
+		{
+			Profiler::Scope scope(profiler, cameraPhase);
+			PanCamera(fElapsedTime);
+			ZoomCamera(fElapsedTime);
+		}
 
-		//INPUT
-		EditObjects(b);
+		if (replaying) {
+			Profiler::Scope scope(profiler, replayPhase);
+			UpdateReplay(fElapsedTime);
+		}
+		else if (!attachName.empty()) {
+			Profiler::Scope scope(profiler, attachPhase);
+			UpdateAttached();
+		}
+		else if (!connectHost.empty()) {
+			Profiler::Scope scope(profiler, remotePhase);
+			if (remote.Read(b, remoteStep)) {
+				bodiesVersion++;
+			}
+		}
+		else {
+			UpdateSimulation(fElapsedTime);
+			PushTelemetry();
+		}
 
-		//print debug values every second
-		if (time > nSec) {
-			nSec += 1;
-			std::cout << " " << nSec << " seconds.\n";
+		//DRAW
+		{
+			Profiler::Scope scope(profiler, cullPhase);
+			UpdateBodyIndex();
+			FollowCenter(b); //before anything is drawn, trails and bodies move with the camera together
+		}
+		if (showTrails) {
+			Profiler::Scope scope(profiler, trailsPhase);
+			if (trailsVersion != bodiesVersion) {
+				trails.Record(b, TRAIL_TOLERANCE / zoomFactor);
+				trailsVersion = bodiesVersion;
+			}
+			Raster::Target target = GetPixelMode() == olc::Pixel::NORMAL ? Raster::Target(GetDrawTarget()) : Raster::Target();
+			trails.Draw(target, b, zoomFactor, worldCenter.x, worldCenter.y);
+		}
+		{
+			Profiler::Scope scope(profiler, drawBodiesPhase);
+			DrawBodies(b);
 		}
 
+		if (toggleVectors) {
+			Profiler::Scope scope(profiler, drawVectorsPhase);
+			DrawBodyVelAndAccVectors(b);
+		}
+
+		if (replaying) {
+			DrawTimeline();
+		}
+		if (!attachName.empty()) {
+			DrawString(2, ScreenHeight() - 10, attached.IsOpen() ? attachName + " step " + std::to_string(attachedStep) : "waiting for " + attachName, olc::WHITE);
+		}
+		if (!connectHost.empty()) {
+			DrawString(2, ScreenHeight() - 10, connectHost + (remote.IsConnected() ? " step " + std::to_string(remoteStep) : " disconnected"), olc::WHITE);
+		}
+
+		if (showProfiler) {
+			Profiler::Scope scope(profiler, overlayPhase);
+			DrawProfilerOverlay();
+		}
+
+		//quit program
+		if (GetKey(IO.inputMap[UI::EXIT]).bPressed) {
+			return false;
+		}
+		if (frameLimit > 0 && ++framesDrawn >= frameLimit) {
+			return false;
+		}
+
+		return true;
+	}
+
+	//bumps bodiesVersion when a step, an edit or a merge changed b. paused and untouched, the gravity pass
+	//only computes the same acc again, so the index gets built and culling stops being a linear pass
+	void UpdateSimulation(float fElapsedTime) {
+		bool changed;
+		//INPUT
+		{
+			Profiler::Scope scope(profiler, editPhase);
+			changed = EditObjects(b);
+		}
+
+		auto physicsStart = std::chrono::steady_clock::now();
+		int bodiesBefore = b.size();
+
 		//UPDATE GRAVITY- GETS CALLED TO UPDATE VECTORS EVEN WHEN PAUSED
 		//update gravity also handles planet collisions as distances are all calculated
-		Body2D::UpdateGravity(b);
+		{
+			Profiler::Scope scope(profiler, gravityPhase);
+			removedRows.clear();
+			Body2D::UpdateGravity(b, physicsThreads, &removedRows);
+			trails.Remove(removedRows);
+		}
+		frameRecord.merges = bodiesBefore - int(b.size()); //every merge removes one body
 
 		//doesnt get called if paused
 		if (GetFPS() >= 20) {
 			if (!pause) {
 
 				//UPDATE POS AND VEL
-				Body2D::UpdateVelandPos(b, fElapsedTime);
+				{
+					Profiler::Scope scope(profiler, integratePhase);
+					Body2D::UpdateVelandPos(b, fElapsedTime);
+				}
+				stepCount++;
+				changed = true;
+
+				if (recorder.IsOpen()) {
+					RecordFrame(b);
+				}
+				if (publisher.IsOpen()) {
+					publisher.Publish(b, stepCount, time);
+				}
+				if (server.IsOpen()) {
+					server.Publish(b, stepCount);
+				}
 			}//end pause if
 			else {
 				DrawSprite(0, 0, pausedSprite);
 			}
 		}
 
-		//DRAW
-		DrawBodies(b);
+		frameRecord.stepMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - physicsStart).count();
+		if (changed || frameRecord.merges != 0) {
+			bodiesVersion++;
+		}
+	}
 
-		if (toggleVectors) {
-			DrawBodyVelAndAccVectors(b);
+	//replaces the old per second std::cout, the energy sample also marks the once a second console line.
+	//the telemetry thread computes it, this frame only copies the bodies
+	void PushTelemetry() {
+		frameRecord.step = stepCount;
+		frameRecord.time = time;
+		frameRecord.bodies = b.size();
+		frameRecord.energy = NAN;
+		if (!telemetry.IsOpen()) {
+			return;
 		}
+		if (time > nSec) {
+			nSec += 1;
+			telemetry.Push(frameRecord, b);
+		}
+		else {
+			telemetry.Push(frameRecord);
+		}
+	}
 
-		//quit program
-		if (GetKey(IO.inputMap[UI::EXIT]).bPressed) {
-			return false;
+	//advances or scrubs the replay and loads the frame into b
+	void UpdateReplay(float fElapsedTime) {
+		if (GetKey(IO.inputMap[UI::REPLAYFASTER]).bPressed) {
+			replaySpeed *= 2;
+		}
+		if (GetKey(IO.inputMap[UI::REPLAYSLOWER]).bPressed && replaySpeed > 1) {
+			replaySpeed /= 2;
+		}
+
+		double first = double(player.FirstStep());
+		double last = double(player.LastStep());
+
+		//arrow keys scrub at ten times the play speed, works while paused
+		if (GetKey(IO.inputMap[UI::REPLAYFORWARD]).bHeld) {
+			replayStep += 10 * replaySpeed * fElapsedTime;
+		}
+		else if (GetKey(IO.inputMap[UI::REPLAYBACK]).bHeld) {
+			replayStep -= 10 * replaySpeed * fElapsedTime;
+		}
+		else if (!pause) {
+			replayStep += replaySpeed * fElapsedTime;
+		}
+
+		//click or drag on the timeline to jump
+		if (GetMouse(L_CLICK).bHeld && GetMouseY() >= ScreenHeight() - TIMELINE_HEIGHT) {
+			replayStep = first + (last - first) * GetMouseX() / float(ScreenWidth() - 1);
 		}
 
+		if (replayStep < first) {
+			replayStep = first;
+		}
+		if (replayStep > last) {
+			replayStep = last;
+		}
+
+		uint64_t shownStep = replayFrame.step;
+		if (!player.Seek(uint64_t(replayStep), replayFrame)) {
+			return;
+		}
+		if (replayFrame.step != shownStep || int(b.size()) != int(replayFrame.count)) {
+			bodiesVersion++;
+		}
+		if (replayFrame.step < shownStep) {
+			trails.Clear(); //scrubbing back would draw the trail over itself
+		}
+
+		int len = replayFrame.count;
+		b.resize(len);
+		for (int counter = 0; counter < len; counter++) {
+			b[counter].pos = Vec2D(replayFrame.x[counter], replayFrame.y[counter]);
+			b[counter].vel = Vec2D(0, 0);
+			b[counter].acc = Vec2D(0, 0);
+			b[counter].mass = replayFrame.mass[counter];
+			b[counter].radius = replayFrame.radius[counter];
+			b[counter].color = replayFrame.color[counter];
+			b[counter].active = true;
+		}
+	}
+
+	//newest frame of the attached run, the previous one stays when there is nothing new
+	void UpdateAttached() {
+		if (!attached.IsOpen() && !attached.Open(attachName)) {
+			return;
+		}
+		if (attached.Read(b, attachedStep)) {
+			bodiesVersion++;
+		}
+	}
+
+	void DrawTimeline() {
+		double first = double(player.FirstStep());
+		double last = double(player.LastStep());
+		float progress = (last > first) ? float((replayStep - first) / (last - first)) : 0.0f;
+
+		int top = ScreenHeight() - TIMELINE_HEIGHT;
+		FillRect(0, top, ScreenWidth(), TIMELINE_HEIGHT, olc::VERY_DARK_GREY);
+		FillRect(0, top, int(progress * ScreenWidth()), TIMELINE_HEIGHT, olc::DARK_CYAN);
+		DrawString(2, top + 2, "step " + std::to_string(uint64_t(replayStep)) + " / " + std::to_string(uint64_t(last)) + "  " + std::to_string(int(replaySpeed)) + " steps/s", olc::WHITE);
+	}
+
+	bool OnUserDestroy() override
+	{
+		if (capturing) {
+			CaptureFrame(); //the last frame was displayed after the last update
+			ToggleCapture();
+		}
+		recorder.Close();
+		if (telemetry.IsOpen()) {
+			telemetry.Close();
+			if (telemetry.Dropped() > 0) {
+				std::cout << "telemetry dropped " << telemetry.Dropped() << " records, the ring was full\n";
+			}
+		}
+		publisher.Close();
+		server.Close();
+		remote.Close();
+		atlas.Release();
 		return true;
 	}
 
-	void DrawBody(Body2D b) {
-		if (b.active) {
-			FillCircle((b.pos.x * zoomFactor) + worldCenter.x, (b.pos.y * zoomFactor) + worldCenter.y, b.radius * zoomFactor, b.color);
+	//uploads the layer sprite and draws it with its decals, what olc_CoreUpdate does for layers without a hook
+	void DrawLayer(olc::LayerDesc &layer) {
+		Profiler::Scope scope(profiler, uploadPhase);
+
+		olc::renderer->ApplyTexture(layer.nResID);
+		if (layer.bUpdate) {
+			olc::renderer->UpdateTextureDirty(layer.nResID, layer.pDrawTarget);
+			layer.pDrawTarget->MarkUploaded();
+			layer.bUpdate = false;
 		}
+
+		olc::renderer->DrawLayerQuad(layer.vOffset, layer.vScale, layer.tint);
+
+		olc::renderer->DrawDecalQuads(layer.vecDecalInstance.data(), layer.vecDecalInstance.size());
+		layer.vecDecalInstance.clear();
 	}
 
-	void DrawBodies(std::vector<Body2D>& b) {
-		//int len = sizeof(b) -1;
-		int len = b.size();
+	//all bodies of a frame in one batched draw, the layer's own sprite stays empty
+	void DrawDecalLayer(olc::LayerDesc &layer) {
+		Profiler::Scope scope(profiler, decalPhase);
 
-		for (int counter = 0; counter < len; counter++) {
+		olc::renderer->DrawDecalQuads(layer.vecDecalInstance.data(), layer.vecDecalInstance.size());
+		layer.vecDecalInstance.clear();
+	}
 
-			//make sure worldcenter is corrected if there is a planet that is supposed to be the center
-			if (b[counter].toggleAsCenter && !isDragging) {
+	void ToggleTraceCapture() {
+		if (!profiler.Capturing()) {
+			profiler.StartCapture();
+			std::cout << "trace capture started\n";
+		}
+		else if (profiler.StopCapture(tracePath)) {
+			std::cout << "trace written to " << tracePath << "\n";
+		}
+	}
 
-				worldCenter.x = (ScreenWidth() / 2) - b[counter].pos.x;
-				worldCenter.y = (ScreenHeight() / 2) - b[counter].pos.y;
+	//stacked graph of the last frames, newest on the right, with the average of every phase
+	void DrawProfilerOverlay() {
+		const int graphWidth = Profiler::HISTORY_FRAMES;
+		const int graphHeight = 100;
+		const float pixelsPerMs = graphHeight / 33.3f; //two frames at 60 fps fill the graph
+		const olc::Pixel phaseColors[] = { olc::CYAN, olc::MAGENTA, olc::RED, olc::YELLOW, olc::DARK_CYAN,
+			olc::GREEN, olc::BLUE, olc::DARK_GREY, olc::WHITE };
+		const int colorCount = sizeof(phaseColors) / sizeof(phaseColors[0]);
+
+		int left = 4, top = 4;
+		FillRect(left, top, graphWidth, graphHeight, olc::VERY_DARK_GREY);
+		int stored = profiler.FramesStored();
+		for (int age = 0; age < stored && age < graphWidth; age++) {
+			int x = left + graphWidth - 1 - age;
+			float y = float(top + graphHeight);
+			for (int phase = 0; phase < profiler.PhaseCount(); phase++) {
+				float h = profiler.PhaseMs(phase, age) * pixelsPerMs;
+				if (h >= 0.5f) {
+					DrawLine(x, int(y), x, int(y - h), phaseColors[phase % colorCount]);
+				}
+				y -= h;
 			}
-			//cancel center if camera if being panned
-			if (isDragging) {
-				b[counter].toggleAsCenter = false;
+
+			//the rest of the frame is engine time we do not see, vsync and input
+			int frameTop = int(top + graphHeight - profiler.FrameMs(age) * pixelsPerMs);
+			if (frameTop >= top) {
+				Draw(x, frameTop, olc::DARK_RED);
 			}
+		}
+		DrawLine(left, int(top + graphHeight - 16.7f * pixelsPerMs), left + graphWidth, int(top + graphHeight - 16.7f * pixelsPerMs), olc::DARK_GREY, 0xF0F0F0F0);
 
-			DrawBody(b[counter]);
+		int textY = top + graphHeight + 4;
+		DrawString(left, textY, "frame " + FormatMs(profiler.AverageFrameMs()) + (profiler.Capturing() ? "  capturing" : ""), olc::WHITE);
+		if (profiler.TracksAllocations()) {
+			DrawString(left + 8 * 28, textY, "steady frames allocating " + std::to_string(profiler.SteadyAllocFrames()),
+				profiler.FrameFlagged() ? olc::RED : olc::WHITE);
+		}
+		for (int phase = 0; phase < profiler.PhaseCount(); phase++) {
+			textY += 10;
+			FillRect(left, textY, 8, 8, phaseColors[phase % colorCount]);
+			DrawString(left + 12, textY, FormatMs(profiler.AveragePhaseMs(phase)) + " " + profiler.PhaseName(phase), olc::WHITE);
+			if (profiler.TracksAllocations()) {
+				DrawString(left + 12 + 8 * 36, textY, FormatAllocs(phase), profiler.FrameAllocs(phase) > 0 ? olc::RED : olc::WHITE);
+			}
+			if (profiler.CountersEnabled()) {
+				DrawString(left + 12 + 8 * 54, textY, FormatCounters(phase), olc::WHITE);
+			}
+		}
+		if (profiler.TracksAllocations()) {
+			textY += 10;
+			DrawString(left + 12 + 8 * 10, textY, "no scope", olc::WHITE);
+			DrawString(left + 12 + 8 * 36, textY, FormatAllocs(AllocTracker::NO_SCOPE), olc::WHITE);
+			textY += 10;
+			DrawString(left + 12 + 8 * 10, textY, "other threads", olc::WHITE);
+			DrawString(left + 12 + 8 * 36, textY, FormatAllocs(AllocTracker::OTHER_THREADS), olc::WHITE);
 		}
 	}
 
-	void DrawBodyVelAndAccVectors(std::vector<Body2D> &b) {
-		
-		//at min draw arrow length 1, max length 50
-		//int min = 0;
-		//int max = 1000000;
-		
-		//vectorScale is scale vector factor - later add realism or sense of scale to this
-		
+	//instructions per cycle and misses per body per frame, over the last counter window
+	std::string FormatCounters(int phase) {
+		char text[96];
+		snprintf(text, sizeof(text), "ipc %4.2f  cache/body %6.2f  branch/body %6.2f", profiler.PhaseCounters(phase).Ipc(),
+			profiler.CacheMissesPerBody(phase), profiler.BranchMissesPerBody(phase));
+		return text;
+	}
 
-		for (int counter = 0; counter < b.size(); counter++) {
+	//allocations and bytes of the last frame
+	std::string FormatAllocs(int phase) {
+		char text[48];
+		snprintf(text, sizeof(text), "%5llu new %8llu B", (unsigned long long)profiler.FrameAllocs(phase),
+			(unsigned long long)profiler.FrameAllocBytes(phase));
+		return text;
+	}
 
-			Vec2D vel = Vec2D(b[counter].vel.x, b[counter].vel.y *-1);
-			
-			//either clamp between two values which is irretrievable, or scale which is retrievable
-			//vel.clamp(min, max);
-			vel.scale(vectorScale);
+	//per phase allocations made in steady state frames, printed once the window has closed
+	void PrintAllocationReport() {
+		if (!profiler.TracksAllocations()) {
+			return;
+		}
+		std::cout << profiler.SteadyAllocFrames() << " steady state frames allocated\n";
+		for (int phase = AllocTracker::OTHER_THREADS; phase < profiler.PhaseCount(); phase++) {
+			if (profiler.SteadyAllocs(phase) > 0) {
+				std::string name = phase == AllocTracker::OTHER_THREADS ? "other threads" : phase == AllocTracker::NO_SCOPE ? "no scope" : profiler.PhaseName(phase);
+				std::cout << "  " << profiler.SteadyAllocs(phase) << " allocations in " << name << "\n";
+			}
+		}
+	}
+
+	static std::string FormatMs(float ms) {
+		char text[32];
+		snprintf(text, sizeof(text), "%6.2f ms", ms);
+		return text;
+	}
+
+	void ToggleRecording() {
+		if (recorder.IsOpen()) {
+			recorder.Close();
+			std::cout << "recording stopped, " << recorder.FramesRecorded() << " frames, " << recorder.FramesDropped() << " dropped, " << recorder.BytesWritten() << " bytes\n";
+		}
+		else if (recorder.Open(recordPath)) {
+			std::cout << "recording to " << recordPath << "\n";
+		}
+	}
+
+	void ToggleCapture() {
+		capturing = !capturing;
+		olc::renderer->KeepFrames(capturing);
+		if (!capturing && capture.IsOpen()) {
+			capture.Close();
+			std::cout << "capture stopped, " << capture.FramesCaptured() << " frames, " << capture.FramesDropped() << " dropped, "
+				<< capture.FramesSkipped() << " skipped, " << capture.FramesFailed() << " failed, " << capture.BytesWritten() << " bytes\n";
+		}
+	}
+
+	//the frame displayed last, copied into the exporter's buffers
+	void CaptureFrame() {
+		olc::Sprite* frame = olc::renderer->GetFrame();
+		if (frame == nullptr) {
+			return; //nothing read back yet
+		}
+		if (!capture.IsOpen()) {
+			if (!capture.Open(capturePath, frame->width, frame->height, captureOptions)) {
+				std::cout << "could not capture to " << capturePath << "\n";
+				ToggleCapture();
+				return;
+			}
+			std::cout << "capturing to " << capturePath << "\n";
+		}
+		capture.Submit((const uint32_t*)frame->GetData(), frame->width, frame->height);
+	}
+
+	//copies the current step into the recorder queue, only touches preallocated slots
+	void RecordFrame(std::vector<Body2D> &b) {
+		Trajectory::Frame* f = recorder.BeginFrame();
+		if (f == nullptr) {
+			return;
+		}
 
-			vel = Vec2D::VectorAdd(vel, b[counter].pos);
+		int len = b.size();
+		f->step = stepCount;
+		f->Resize(len);
+		for (int counter = 0; counter < len; counter++) {
+			f->x[counter] = b[counter].pos.x;
+			f->y[counter] = b[counter].pos.y;
+			f->mass[counter] = b[counter].mass;
+			f->radius[counter] = b[counter].radius;
+			f->color[counter] = b[counter].color;
+		}
+		recorder.CommitFrame();
+	}
 
+	//target has no data when the pixel mode blends, then olc draws the circle
+	void DrawBody(const Body2D &b, const Raster::Target &target) {
+		if (!b.active) {
+			return;
+		}
+		float x = (b.pos.x * zoomFactor) + worldCenter.x, y = (b.pos.y * zoomFactor) + worldCenter.y;
+		if (drawDecals) {
+			DrawBodyDecal(x, y, b.radius * zoomFactor, b.color);
+		}
+		else if (target.data != nullptr) {
+			Raster::FillCircle(target, x, y, b.radius * zoomFactor, b.color);
+		}
+		else {
+			FillCircle(x, y, b.radius * zoomFactor, b.color);
+		}
+	}
 
-			Vec2D acc = Vec2D(b[counter].acc.x, b[counter].acc.y * -1);
-			//acc.clamp(min, max);
-			acc.scale(vectorScale);
+	//the nearest atlas disc scaled to the body, a quad whatever the size. bodies under half a pixel are left out
+	void DrawBodyDecal(float x, float y, float r, olc::Pixel color) {
+		if (!(r >= 0.5f && x + r >= 0 && x - r < ScreenWidth() && y + r >= 0 && y - r < ScreenHeight())) {
+			return;
+		}
+		int level = Raster::CircleAtlas::Level(r);
+		float size = float(2 * Raster::CircleAtlas::Radius(level));
+		DrawPartialDecal(olc::vf2d(x - r, y - r), atlas.decal, atlas.Position(level), olc::vf2d(size, size), olc::vf2d(2 * r / size, 2 * r / size), color);
+	}
 
-			acc = Vec2D::VectorAdd(acc, b[counter].pos);
+	//builds the index once the bodies held still for a frame, finds the body the camera follows when they changed
+	void UpdateBodyIndex() {
+		bool changed = bodiesVersion != lastFrameVersion;
+		lastFrameVersion = bodiesVersion;
+		if (!changed && indexedVersion != bodiesVersion) {
+			bodyIndex.Build(b);
+			indexedVersion = bodiesVersion;
+		}
+		if (!changed) {
+			return;
+		}
+		centerIndex = -1;
+		int len = b.size();
+		for (int counter = 0; counter < len; counter++) {
+			if (b[counter].toggleAsCenter) {
+				centerIndex = counter; //the last one wins, as it did when drawing set the centre
+			}
+		}
+	}
 
-			//only set velocity vector arrow if its not being changed
-			if (vectorDraggingIndex == -1) {
-				b[counter].velDrawArrowEnd = Vec2D(vel.x, vel.y);
+	//make sure worldcenter is corrected if there is a planet that is supposed to be the center, panning cancels it
+	void FollowCenter(std::vector<Body2D> &b) {
+		if (centerIndex < 0 || centerIndex >= int(b.size()) || !b[centerIndex].toggleAsCenter) {
+			return;
+		}
+		if (isDragging) {
+			for (Body2D &body : b) {
+				body.toggleAsCenter = false;
 			}
-			
-			DrawVector(b[counter].pos, b[counter].velDrawArrowEnd, olc::RED);
-			DrawVector(b[counter].pos, acc, olc::GREEN);
+			centerIndex = -1;
+			return;
+		}
+		worldCenter.x = (ScreenWidth() / 2) - b[centerIndex].pos.x;
+		worldCenter.y = (ScreenHeight() / 2) - b[centerIndex].pos.y;
+	}
+
+	//bodies that can draw on screen in array order, their circle or with vectors their arrows
+	void QueryScreen(bool vectors, std::vector<int> &out) {
+		float x0 = (0 - worldCenter.x) / zoomFactor, x1 = (ScreenWidth() - worldCenter.x) / zoomFactor;
+		float y0 = (0 - worldCenter.y) / zoomFactor, y1 = (ScreenHeight() - worldCenter.y) / zoomFactor;
+		if (indexedVersion == bodiesVersion) {
+			float pad = vectors ? std::max(bodyIndex.MaxVel(), bodyIndex.MaxAcc()) * vectorScale + ARROWHEAD_REACH : bodyIndex.MaxRadius();
+			bodyIndex.Query(x0 - pad, y0 - pad, x1 + pad, y1 + pad, out);
+			return;
+		}
+
+		out.clear();
+		int len = b.size();
+		for (int counter = 0; counter < len; counter++) {
+			const Body2D &body = b[counter];
+			float pad = body.radius;
+			if (vectors) {
+				//|x| + |y| is never less than the length
+				float reach = std::max(std::abs(body.vel.x) + std::abs(body.vel.y), std::abs(body.acc.x) + std::abs(body.acc.y));
+				pad = reach * vectorScale + ARROWHEAD_REACH;
+			}
+			if (body.active && body.pos.x + pad >= x0 && body.pos.x - pad <= x1 && body.pos.y + pad >= y0 && body.pos.y - pad <= y1) {
+				out.push_back(counter);
+			}
+		}
+	}
+
+	void DrawBodies(std::vector<Body2D>& b) {
+		QueryScreen(false, visible);
+
+		Raster::Target target = GetPixelMode() == olc::Pixel::NORMAL ? Raster::Target(GetDrawTarget()) : Raster::Target();
+		if (UpdateDensityView() && target.data != nullptr) {
+			//splat the small bodies, the rest are drawn over the density map as usual
+			splatted.clear();
+			size_t kept = 0;
+			for (int counter : visible) {
+				if (b[counter].radius * zoomFactor < SPLAT_RADIUS) {
+					splatted.push_back(counter);
+				}
+				else {
+					visible[kept++] = counter;
+				}
+			}
+			visible.resize(kept);
+			density.Accumulate(b, splatted, zoomFactor, worldCenter.x, worldCenter.y, target.width, target.height, physicsThreads);
+			density.Resolve(target, physicsThreads);
+		}
+
+		if (!drawDecals && target.data != nullptr) {
+			circles.Clear();
+			for (int counter : visible) {
+				const Body2D &body = b[counter];
+				if (body.active) {
+					circles.Add((body.pos.x * zoomFactor) + worldCenter.x, (body.pos.y * zoomFactor) + worldCenter.y, body.radius * zoomFactor, body.color);
+				}
+			}
+			circles.Draw(target, physicsThreads);
+			return;
+		}
+
+		if (drawDecals) {
+			SetDrawTarget(bodyLayer); //decals go to the current target layer
+		}
+		for (int counter : visible) {
+			DrawBody(b[counter], target);
+		}
+		if (drawDecals) {
+			SetDrawTarget(nullptr);
+		}
+	}
+
+	//decides from the visible bodies and their mean size on screen, with some hysteresis so it does not flicker
+	bool UpdateDensityView() {
+		size_t count = visible.size();
+		double radius = 0;
+		for (int counter : visible) {
+			radius += b[counter].radius;
+		}
+		float meanRadius = count > 0 ? float(radius / count) * zoomFactor : 0;
+		if (!densityView) {
+			densityView = count >= size_t(DENSITY_BODIES) && meanRadius < DENSITY_RADIUS;
+		}
+		else {
+			densityView = count >= size_t(DENSITY_BODIES * 0.8f) && meanRadius < DENSITY_RADIUS * 1.25f;
+		}
+		return densityView;
+	}
+
+	//arrows from each body to pos + vel * vectorScale and pos + acc * vectorScale, y flipped, laid out and drawn as
+	//one batch. the dragged arrow is drawn wherever it is
+	void DrawBodyVelAndAccVectors(std::vector<Body2D> &b) {
+		QueryScreen(true, visible);
+		if (vectorDraggingIndex >= 0 && vectorDraggingIndex < int(b.size()) && !std::binary_search(visible.begin(), visible.end(), vectorDraggingIndex)) {
+			visible.insert(std::lower_bound(visible.begin(), visible.end(), vectorDraggingIndex), vectorDraggingIndex);
+		}
+
+		//only set velocity vector arrows if one is not being changed. every body's, DragVectors grabs any of them
+		if (vectorDraggingIndex == -1) {
+			for (Body2D &body : b) {
+				body.velDrawArrowEnd.x = body.pos.x + body.vel.x * vectorScale;
+				body.velDrawArrowEnd.y = body.pos.y - body.vel.y * vectorScale;
+			}
+		}
+
+		arrows.Clear();
+		for (int counter : visible) {
+			Body2D &body = b[counter];
+			arrows.Add(body.pos.x, body.pos.y, body.velDrawArrowEnd.x, body.velDrawArrowEnd.y, olc::RED);
+			arrows.Add(body.pos.x, body.pos.y, body.pos.x + body.acc.x * vectorScale, body.pos.y - body.acc.y * vectorScale, olc::GREEN);
+		}
+		arrows.Layout(zoomFactor, worldCenter.x, worldCenter.y, ScreenWidth(), ScreenHeight());
+
+		Raster::Target target = GetPixelMode() == olc::Pixel::NORMAL ? Raster::Target(GetDrawTarget()) : Raster::Target();
+		if (target.data != nullptr) {
+			arrows.Draw(target);
+		}
+		else {
+			arrows.Lines([this](float ax, float ay, float bx, float by, olc::Pixel p) { DrawLine(int32_t(ax), int32_t(ay), int32_t(bx), int32_t(by), p); });
 		}
 	}
 
@@ -575,13 +1003,16 @@ public:
 	}
 
 	//collects various input that will add, delete, add or subtract mass, or move planets
-	void EditObjects(std::vector<Body2D> &b) {
+	//returns whether b may have changed, every edit happens on a click or on releasing a dragged vector
+	bool EditObjects(std::vector<Body2D> &b) {
 		//add body
 		if (GetKey(IO.inputMap[UI::ADDBODY]).bHeld && GetMouse(L_CLICK).bPressed) {
 			Body2D::AddBodyAt(b, Vec2D((GetMouseX() - worldCenter.x)/zoomFactor, (GetMouseY() - worldCenter.y) / zoomFactor));
 		}
 		else if (GetKey(IO.inputMap[UI::DELETEBODY]).bHeld && GetMouse(L_CLICK).bPressed) {
-			Body2D::DeleteBodyAt(b, Vec2D((GetMouseX() - worldCenter.x) / zoomFactor, (GetMouseY() - worldCenter.y) / zoomFactor));
+			removedRows.clear();
+			Body2D::DeleteBodyAt(b, Vec2D((GetMouseX() - worldCenter.x) / zoomFactor, (GetMouseY() - worldCenter.y) / zoomFactor), &removedRows);
+			trails.Remove(removedRows);
 		}
 		else if(GetKey(IO.inputMap[UI::ADDMASS]).bHeld && GetMouse(L_CLICK).bPressed) {
 			Body2D::AddMassAt(b, Vec2D((GetMouseX() - worldCenter.x) / zoomFactor, (GetMouseY() - worldCenter.y) / zoomFactor));
@@ -596,33 +1027,7 @@ public:
 		if (GetMouse(L_CLICK).bPressed) {
 			//std::cout << "L CLICK\n";
 		}
-	}
-
-	void DrawVector(Vec2D origin, Vec2D end, olc::Pixel color = olc::WHITE) {
-		//center line
-		DrawLine((origin.x * zoomFactor) + worldCenter.x, (origin.y * zoomFactor) + worldCenter.y, (end.x*zoomFactor) + worldCenter.x, (end.y*zoomFactor) + worldCenter.y, color);
-
-		//draw arrowheads
-		float angleForArrowHeads = 30 * (3.141596 / 180.0);
-		float magForArrowHeads = 20;
-
-		float lenSquared = Vec2D(origin.x - end.x, origin.y - end.y).magSquared();
-
-		magForArrowHeads = lenSquared / 100;
-		if (magForArrowHeads > 20) {
-			magForArrowHeads = 20;
-		}
-		else if(lenSquared < 15){
-			magForArrowHeads = .1;
-		}
-
-		float angleBetween = origin.angleBetween(end);
-		float theta1 = angleBetween + angleForArrowHeads;
-
-		float theta2 = angleBetween - angleForArrowHeads;
-
-		DrawLine((end.x*zoomFactor) + worldCenter.x, (end.y*zoomFactor) + worldCenter.y, (end.x - magForArrowHeads*sin(theta1))*zoomFactor + worldCenter.x, (end.y - magForArrowHeads*cos(theta1))*zoomFactor + worldCenter.y, color);
-		DrawLine((end.x*zoomFactor) + worldCenter.x, (end.y*zoomFactor) + worldCenter.y, (end.x - magForArrowHeads * sin(theta2))*zoomFactor + worldCenter.x, (end.y - magForArrowHeads * cos(theta2))*zoomFactor + worldCenter.y, color);
+		return GetMouse(L_CLICK).bPressed || GetMouse(L_CLICK).bReleased;
 	}
 
 	//allows user to click and drag on velocity vectors
@@ -690,15 +1095,74 @@ public:
 
 };
 
-int main()
+int main(int argc, char* argv[])
 {
 	//while (1) {}
 
 	Graphics g;
+
+	//Gravity --replay file.g2dt opens a recording instead of starting the simulation
+	//Gravity --telemetry file.csv writes every frame's telemetry record instead of the console summary
+	//Gravity --publish name publishes every step to shared memory, Gravity --attach name shows a run published that way
+	//Gravity --serve port streams the run over tcp at --serve-rate hz, Gravity --connect host:port shows a run streamed that way
+	//Gravity --frames n quits after n frames
+	//Gravity --trails points draws orbit trails from the start, out of that many points shared by all bodies, 0 for the default
+	//Gravity --capture run.y4m starts capturing straight away, --capture-policy drop|throttle|wait and --capture-every n
+	//decide which frames are kept
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--replay") {
+			g.replayPath = argv[i + 1];
+		}
+		else if (std::string(argv[i]) == "--telemetry") {
+			g.telemetryPath = argv[i + 1];
+		}
+		else if (std::string(argv[i]) == "--publish") {
+			g.publishName = argv[i + 1];
+		}
+		else if (std::string(argv[i]) == "--attach") {
+			g.attachName = argv[i + 1];
+		}
+		else if (std::string(argv[i]) == "--serve") {
+			g.servePort = std::stoi(argv[i + 1]);
+		}
+		else if (std::string(argv[i]) == "--serve-rate") {
+			g.serveRate = std::stof(argv[i + 1]);
+		}
+		else if (std::string(argv[i]) == "--capture") {
+			g.capturePath = argv[i + 1];
+			g.capturing = true;
+		}
+		else if (std::string(argv[i]) == "--capture-policy") {
+			std::string policy = argv[i + 1];
+			g.captureOptions.policy = policy == "wait" ? Capture::WAIT : policy == "throttle" ? Capture::THROTTLE : Capture::DROP;
+		}
+		else if (std::string(argv[i]) == "--capture-every") {
+			g.captureOptions.every = std::stoi(argv[i + 1]);
+		}
+		else if (std::string(argv[i]) == "--frames") {
+			g.frameLimit = std::stoi(argv[i + 1]);
+		}
+		else if (std::string(argv[i]) == "--trails") {
+			int points = std::stoi(argv[i + 1]);
+			g.trails.SetBudget(points > 0 ? points : int(Trails::DEFAULT_BUDGET));
+			g.showTrails = true;
+		}
+		else if (std::string(argv[i]) == "--connect") {
+			std::string target = argv[i + 1];
+			size_t colon = target.rfind(':');
+			g.connectHost = target.substr(0, colon);
+			g.connectPort = colon == std::string::npos ? Stream::DEFAULT_PORT : std::stoi(target.substr(colon + 1));
+			if (g.connectHost.size() > 2 && g.connectHost.front() == '[' && g.connectHost.back() == ']') {
+				g.connectHost = g.connectHost.substr(1, g.connectHost.size() - 2); //[::1]:5555
+			}
+		}
+	}
+
 	if (g.Construct(900, 900, 1, 1))
 		g.Start();
 
 	g.OnUserDestroy();
+	g.PrintAllocationReport();
 
 	return 0;
 }
@@ -709,7 +1173,7 @@ int main()
 //PLANETS COMBINE MASS WHEN THEY COLLIDE - done
 //PAUSING - done, can add pause menu
 
-//PATH TRACING
+//PATH TRACING - done, O toggles orbit trails
 //ADD PLANETS ON THE FLY, CLICK, PROMPT POPS UP, TYPE MASS, SO ON, AND PLANET APPEARS
 //INTERACTIVE GAME SOMETHING
 //LIGHT SOURCES
@@ -726,7 +1190,7 @@ int main()
 
 //space to pause simulation , but doesnt go to pause menu, allows freezing time - done
 
-//SWITCH FROM DRAWING PIXEL CIRCLES TO DRAWING DECALS WITH DIFFERENT COLORS AND DIFFERENT SIZES FOR PLANETS AND STARS, WILL INCREASE PERFORMANCE SIGNIFICANTLY
+//SWITCH FROM DRAWING PIXEL CIRCLES TO DRAWING DECALS WITH DIFFERENT COLORS AND DIFFERENT SIZES FOR PLANETS AND STARS, WILL INCREASE PERFORMANCE SIGNIFICANTLY - done, B toggles
 //DRAG VECTORS TO GIVE PLANETS INITIAL VELOCITY
 //INCREASE SIZE OF PLANETS THAT SWALLOW OTHER PLANETS - done
 
@@ -0,0 +1,197 @@
+#pragma once
+#include "Physics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+//Finds the bodies inside a rectangle without looking at the others, so drawing costs what is on screen.
+//Bodies are sorted by the Morton code of their position, 24 bits per axis inside the bounds of all bodies, which
+//makes every quadtree cell one contiguous range of the sorted array. A query walks that implicit quadtree from the
+//root with binary searches, takes cells inside the rectangle whole and only tests bodies one by one in small cells
+//on its edge. The 24 bit grid is fine enough that a few escaped bodies stretching the bounds cost next to nothing.
+//
+//Build() is one pass over the bodies plus a radix sort of the codes, linear in the number of bodies and cheap next
+//to transforming and drawing them.
+class SpatialIndex {
+public:
+	static const int LEAF_BODIES = 16; //cells this small are tested body by body instead of split further
+	static const int GRID_BITS = 24; //per axis
+	static const int DIGIT_BITS = 12; //radix sort passes are GRID_BITS * 2 / DIGIT_BITS
+
+	//positions at the time of the build, bodies that are inactive or not finite are left out
+	void Build(const std::vector<Body2D> &b) {
+		int len = b.size();
+		maxRadius = 0;
+		maxVel = 0;
+		maxAcc = 0;
+		float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+		for (int counter = 0; counter < len; counter++) {
+			const Body2D &body = b[counter];
+			if (!Indexed(body)) {
+				continue;
+			}
+			minX = std::min(minX, body.pos.x); maxX = std::max(maxX, body.pos.x);
+			minY = std::min(minY, body.pos.y); maxY = std::max(maxY, body.pos.y);
+			maxRadius = std::max(maxRadius, float(body.radius));
+			maxVel = std::max(maxVel, body.vel.x * body.vel.x + body.vel.y * body.vel.y);
+			maxAcc = std::max(maxAcc, body.acc.x * body.acc.x + body.acc.y * body.acc.y);
+		}
+		maxVel = std::sqrt(maxVel);
+		maxAcc = std::sqrt(maxAcc);
+		originX = minX;
+		originY = minY;
+		scaleX = maxX > minX ? GRID_MAX / (double(maxX) - minX) : 0;
+		scaleY = maxY > minY ? GRID_MAX / (double(maxY) - minY) : 0;
+
+		entries.clear();
+		for (int counter = 0; counter < len; counter++) {
+			if (Indexed(b[counter])) {
+				uint32_t qx = Quantize(b[counter].pos.x, originX, scaleX), qy = Quantize(b[counter].pos.y, originY, scaleY);
+				entries.push_back(Entry{ Interleave(qx) | (Interleave(qy) << 1), counter });
+			}
+		}
+		RadixSort();
+	}
+
+	//indices of the bodies whose position is inside the rectangle, ascending so drawing keeps the array order.
+	//callers widen the rectangle by whatever a body draws around its position
+	void Query(float x0, float y0, float x1, float y1, std::vector<int> &out) {
+		out.clear();
+		if (entries.empty() || !(x0 <= x1 && y0 <= y1)) {
+			return;
+		}
+		double lx = (double(x0) - originX) * scaleX, hx = (double(x1) - originX) * scaleX;
+		double ly = (double(y0) - originY) * scaleY, hy = (double(y1) - originY) * scaleY;
+		//with every body on one coordinate the scale is 0, the test above the rectangle still holds then
+		if ((scaleX == 0 && (x0 > originX || x1 < originX)) || (scaleY == 0 && (y0 > originY || y1 < originY))) {
+			return;
+		}
+		if (hx < 0 || hy < 0 || lx > GRID_MAX || ly > GRID_MAX) {
+			return;
+		}
+		qx0 = uint32_t(std::max(lx, 0.0)); qx1 = uint32_t(std::min(hx, double(GRID_MAX)));
+		qy0 = uint32_t(std::max(ly, 0.0)); qy1 = uint32_t(std::min(hy, double(GRID_MAX)));
+		Visit(0, 0, 0, 0, entries.size(), out);
+		std::sort(out.begin(), out.end());
+	}
+
+	//largest radius, speed and acceleration magnitude at the build, for widening queries
+	float MaxRadius() { return maxRadius; }
+	float MaxVel() { return maxVel; }
+	float MaxAcc() { return maxAcc; }
+
+private:
+	struct Entry {
+		uint64_t code;
+		int index;
+	};
+
+	static constexpr double GRID_MAX = double((1 << GRID_BITS) - 1);
+
+	std::vector<Entry> entries; //sorted by code
+	std::vector<Entry> scratch;
+	std::vector<uint32_t> count;
+	double originX = 0, originY = 0, scaleX = 0, scaleY = 0;
+	float maxRadius = 0, maxVel = 0, maxAcc = 0;
+	uint32_t qx0 = 0, qx1 = 0, qy0 = 0, qy1 = 0; //the current query in grid coordinates
+
+	static bool Indexed(const Body2D &body) {
+		return body.active && std::isfinite(body.pos.x) && std::isfinite(body.pos.y);
+	}
+
+	static uint32_t Quantize(float v, double origin, double scale) {
+		return uint32_t(std::min(std::max((double(v) - origin) * scale, 0.0), double(GRID_MAX)));
+	}
+
+	//spreads the bits of v to the even bits of the result
+	static uint64_t Interleave(uint32_t v) {
+		uint64_t x = v;
+		x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+		x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+		x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+		x = (x | (x << 2)) & 0x3333333333333333ull;
+		x = (x | (x << 1)) & 0x5555555555555555ull;
+		return x;
+	}
+
+	//the even bits of code packed together again
+	static uint32_t Deinterleave(uint64_t code) {
+		uint64_t x = code & 0x5555555555555555ull;
+		x = (x | (x >> 1)) & 0x3333333333333333ull;
+		x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+		x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+		x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+		x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+		return uint32_t(x);
+	}
+
+	//least significant digit first, each pass stable. digits that are the same in every code are skipped
+	void RadixSort() {
+		const int buckets = 1 << DIGIT_BITS;
+		uint64_t all = ~uint64_t(0), any = 0;
+		for (const Entry &e : entries) {
+			all &= e.code;
+			any |= e.code;
+		}
+		scratch.resize(entries.size());
+		count.resize(buckets + 1);
+		for (int shift = 0; shift < 2 * GRID_BITS; shift += DIGIT_BITS) {
+			if (((all ^ any) >> shift & (buckets - 1)) == 0) {
+				continue;
+			}
+			std::fill(count.begin(), count.end(), 0);
+			for (const Entry &e : entries) {
+				count[(e.code >> shift & (buckets - 1)) + 1]++;
+			}
+			for (int digit = 0; digit < buckets; digit++) {
+				count[digit + 1] += count[digit];
+			}
+			for (const Entry &e : entries) {
+				scratch[count[e.code >> shift & (buckets - 1)]++] = e;
+			}
+			entries.swap(scratch);
+		}
+	}
+
+	//cell (cx, cy) at depth, its bodies are entries[begin, end)
+	void Visit(int depth, uint64_t cx, uint64_t cy, size_t begin, size_t end, std::vector<int> &out) {
+		if (begin == end) {
+			return;
+		}
+		int shift = GRID_BITS - depth;
+		uint64_t cellX0 = cx << shift, cellX1 = ((cx + 1) << shift) - 1;
+		uint64_t cellY0 = cy << shift, cellY1 = ((cy + 1) << shift) - 1;
+		if (cellX0 > qx1 || cellX1 < qx0 || cellY0 > qy1 || cellY1 < qy0) {
+			return;
+		}
+		if (cellX0 >= qx0 && cellX1 <= qx1 && cellY0 >= qy0 && cellY1 <= qy1) {
+			for (size_t i = begin; i < end; i++) {
+				out.push_back(entries[i].index);
+			}
+			return;
+		}
+		if (end - begin <= size_t(LEAF_BODIES) || depth == GRID_BITS) {
+			for (size_t i = begin; i < end; i++) {
+				uint32_t x = Deinterleave(entries[i].code), y = Deinterleave(entries[i].code >> 1);
+				if (x >= qx0 && x <= qx1 && y >= qy0 && y <= qy1) {
+					out.push_back(entries[i].index);
+				}
+			}
+			return;
+		}
+
+		//the four children in code order: x is the low bit of each pair
+		uint64_t first = Interleave(uint32_t(cellX0)) | (Interleave(uint32_t(cellY0)) << 1);
+		uint64_t childSpan = uint64_t(1) << (2 * (shift - 1));
+		size_t bounds[5] = { begin, 0, 0, 0, end };
+		for (int k = 1; k < 4; k++) {
+			uint64_t code = first + k * childSpan;
+			bounds[k] = std::lower_bound(entries.begin() + bounds[k - 1], entries.begin() + end, code,
+				[](const Entry &e, uint64_t c) { return e.code < c; }) - entries.begin();
+		}
+		for (int k = 0; k < 4; k++) {
+			Visit(depth + 1, cx * 2 + (k & 1), cy * 2 + (k >> 1), bounds[k], bounds[k + 1], out);
+		}
+	}
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+//Single producer single consumer ring of preallocated slots.
+//The producer fills a slot in place and publishes it, neither side ever takes a lock or waits on the other.
+//
+//	T* slot = ring.BeginPush();		//producer
+//	if (slot) { fill slot; ring.CommitPush(); }
+//
+//	T* slot = ring.Front();			//consumer
+//	if (slot) { read slot; ring.Pop(); }
+template <typename T>
+class SpscRing {
+public:
+	SpscRing(size_t capacity = 256) : slots(capacity) {}
+
+	//every slot starts as a copy of prototype, so buffers inside it are allocated up front
+	SpscRing(size_t capacity, const T &prototype) : slots(capacity, prototype) {}
+
+	//returns nullptr if the ring is full
+	T* BeginPush() {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= slots.size()) {
+			return nullptr;
+		}
+		return &slots[h % slots.size()];
+	}
+
+	void CommitPush() {
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//returns nullptr if the ring is empty
+	T* Front() {
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &slots[t % slots.size()];
+	}
+
+	void Pop() {
+		tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	std::vector<T> slots;
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
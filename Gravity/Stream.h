@@ -0,0 +1,574 @@
+#pragma once
+#include "Physics.h"
+#include "Recorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+//Streams body states over TCP to remote viewers.
+//
+//	greeting:	"G2DN" | u32 version
+//	message:	u32 payloadBytes | u8 type | payload
+//	KEY:		u64 step | u32 count | f32 minX | f32 minY | f32 maxX | f32 maxY
+//				| per body: varint radius | zigzag varint mass | u32 color | then u16 qx | u16 qy per body | outliers
+//	DELTA:		u64 step | zigzag varint (qx - prev qx) | zigzag varint (qy - prev qy) per body | outliers
+//	outliers:	varint count | per outlier: varint index | f32 x | f32 y
+//
+//Positions are quantized to 16 bits inside bounds fixed at the last key frame, the same scheme and helpers as
+//the trajectory files in Recorder.h. The bounds cover the 1st to 99th percentile plus a margin, so bodies can move
+//for a while before a new key is needed and a few escaped bodies do not cost everyone else their precision.
+//Bodies outside the bounds are sent as floats, their quantized values are clamped and mean nothing.
+//A delta is always against the last frame that client actually got, so a client can skip frames freely.
+//
+//Publish() is called from the simulation loop, keeps at most one frame per 1 / rate seconds and hands it to
+//the server thread through a ring, dropping it when the ring is full. The server thread writes to every client
+//without blocking: a client whose previous frame is still in its socket buffer skips this one.
+namespace Stream {
+
+	const char MAGIC[4] = { 'G', '2', 'D', 'N' };
+	const uint32_t VERSION = 1;
+	const uint8_t KEY = 1;
+	const uint8_t DELTA = 2;
+	const int KEY_INTERVAL = 120; //frames, key frames also carry mass, radius and colour, which deltas do not
+	const float BOUNDS_MARGIN = 0.25f; //of the extent, added on every side
+	const int OUTLIER_FRACTION = 32; //a new key once more than 1 in this many bodies are outside the bounds
+	const int DEFAULT_PORT = 5555; //viewers use it when --connect has no port
+	const uint32_t MAX_MESSAGE_BYTES = 1u << 28; //a client hangs up on anything longer, a key frame of 8 million bodies fits
+	const size_t MIN_KEY_BODY_BYTES = 10; //radius and mass varints, colour and quantized position
+
+	class Server {
+	public:
+		Server(size_t queueFrames = 4) : queue(queueFrames) {}
+
+		~Server() {
+			Close();
+		}
+
+		//listens on port on every interface, rate is frames per second, 0 sends every published step
+		bool Open(int port, float rate = 30) {
+			Close();
+#if defined(__linux__)
+			listener = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, 0);
+			if (listener < 0) {
+				return false;
+			}
+			int on = 1, off = 0;
+			setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)); //ipv4 clients too
+			sockaddr_in6 addr = {};
+			addr.sin6_family = AF_INET6;
+			addr.sin6_addr = in6addr_any;
+			addr.sin6_port = htons(uint16_t(port));
+			if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 8) != 0) {
+				close(listener);
+				listener = -1;
+				return false;
+			}
+			interval = rate > 0 ? 1 / rate : 0;
+			lastPublish = std::chrono::steady_clock::time_point();
+			running = true;
+			thread = std::thread(&Server::ServerThread, this);
+			return true;
+#else
+			(void)port;
+			(void)rate;
+			return false;
+#endif
+		}
+
+		void Close() {
+			if (!thread.joinable()) {
+				return;
+			}
+			running = false;
+			thread.join();
+#if defined(__linux__)
+			for (Connection &c : clients) {
+				close(c.fd);
+			}
+			close(listener);
+#endif
+			clients.clear();
+			clientCount = 0;
+			listener = -1;
+		}
+
+		bool IsOpen() {
+			return thread.joinable();
+		}
+
+		//cheap unless a frame is due, then one copy of the positions. never blocks
+		void Publish(const std::vector<Body2D> &b, uint64_t step) {
+			auto now = std::chrono::steady_clock::now();
+			if (std::chrono::duration<float>(now - lastPublish).count() < interval) {
+				return;
+			}
+			Trajectory::Frame* f = queue.BeginPush();
+			if (f == nullptr) {
+				framesDropped++;
+				return;
+			}
+			lastPublish = now;
+			int len = b.size();
+			f->step = step;
+			f->Resize(len);
+			for (int counter = 0; counter < len; counter++) {
+				f->x[counter] = b[counter].pos.x;
+				f->y[counter] = b[counter].pos.y;
+				f->mass[counter] = b[counter].mass;
+				f->radius[counter] = b[counter].radius;
+				f->color[counter] = b[counter].color;
+			}
+			queue.CommitPush();
+		}
+
+		int Clients() { return clientCount; }
+		uint64_t FramesSent() { return framesSent; }
+		uint64_t FramesDropped() { return framesDropped; } //frames or client sends skipped
+		uint64_t BytesSent() { return bytesSent; }
+
+	private:
+		struct Connection {
+			int fd = -1;
+			std::vector<uint8_t> out; //unsent bytes start at outPos
+			size_t outPos = 0;
+			std::vector<uint16_t> q; //what this client has, for deltas
+			uint64_t epoch = 0; //bounds and attributes the client has, 0 for none
+			int sinceKey = 0;
+		};
+
+		Trajectory::FrameQueue queue;
+		std::thread thread;
+		std::atomic<bool> running{ false };
+		int listener = -1;
+		float interval = 0;
+		std::chrono::steady_clock::time_point lastPublish;
+		std::vector<Connection> clients;
+		std::atomic<int> clientCount{ 0 };
+		std::atomic<uint64_t> framesSent{ 0 }, framesDropped{ 0 }, bytesSent{ 0 };
+
+		//server thread: the current quantization, shared by all clients
+		uint64_t epoch = 0;
+		float minX = 0, minY = 0, maxX = 0, maxY = 0, sx = 0, sy = 0;
+		Trajectory::Frame keyed; //count, mass, radius and colour of the current epoch, positions unused
+		std::vector<uint16_t> q;
+		std::vector<uint32_t> outliers; //indices outside the bounds this frame
+		std::vector<float> sorted;
+
+#if defined(__linux__)
+		void ServerThread() {
+			std::vector<pollfd> polls;
+			while (running) {
+				polls.clear();
+				polls.push_back(pollfd{ listener, POLLIN, 0 });
+				for (Connection &c : clients) {
+					polls.push_back(pollfd{ c.fd, short(POLLIN | (c.outPos < c.out.size() ? POLLOUT : 0)), 0 });
+				}
+				poll(polls.data(), polls.size(), 5);
+
+				for (size_t counter = 0; counter < clients.size(); counter++) {
+					short revents = polls[counter + 1].revents;
+					Connection &c = clients[counter];
+					bool alive = true;
+					if (revents & (POLLIN | POLLHUP | POLLERR)) {
+						char discard[256];
+						ssize_t n = recv(c.fd, discard, sizeof(discard), 0);
+						alive = n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+					}
+					if (alive && (revents & POLLOUT)) {
+						alive = Flush(c);
+					}
+					if (!alive) {
+						close(c.fd);
+						clients[counter] = std::move(clients.back());
+						clients.pop_back();
+						polls[counter + 1] = polls[clients.size() + 1];
+						counter--;
+					}
+				}
+				if (polls[0].revents & POLLIN) {
+					Accept();
+				}
+				clientCount = int(clients.size());
+
+				Trajectory::Frame* f = queue.Front();
+				if (f != nullptr) {
+					Quantize(*f);
+					for (Connection &c : clients) {
+						if (c.outPos < c.out.size()) {
+							framesDropped++; //still sending the last one, this client skips a frame
+							continue;
+						}
+						Encode(c, *f);
+						Flush(c);
+						framesSent++;
+					}
+					queue.Pop();
+				}
+			}
+		}
+
+		void Accept() {
+			while (true) {
+				int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+				if (fd < 0) {
+					return;
+				}
+				int on = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+				Connection c;
+				c.fd = fd;
+				c.out.insert(c.out.end(), MAGIC, MAGIC + 4);
+				Trajectory::PutU32(c.out, VERSION);
+				if (Flush(c)) {
+					clients.push_back(std::move(c));
+				}
+				else {
+					close(fd);
+				}
+			}
+		}
+
+		//false when the client is gone
+		bool Flush(Connection &c) {
+			while (c.outPos < c.out.size()) {
+				ssize_t n = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+				if (n < 0) {
+					return errno == EAGAIN || errno == EWOULDBLOCK;
+				}
+				c.outPos += n;
+				bytesSent += n;
+			}
+			c.out.clear();
+			c.outPos = 0;
+			return true;
+		}
+#else
+		void ServerThread() {}
+#endif
+
+		//new bounds whenever the count, a mass, radius or colour changes or too many bodies are outside the old
+		//ones. deltas only carry positions, so every client needs a key with the new attributes
+		void Quantize(const Trajectory::Frame &f) {
+			uint32_t n = f.count;
+			FindOutliers(f);
+			if (epoch == 0 || !keyed.SameBodies(f) || outliers.size() > 4 + n / OUTLIER_FRACTION) {
+				epoch++;
+				keyed.Resize(n);
+				std::copy(f.mass.begin(), f.mass.begin() + n, keyed.mass.begin());
+				std::copy(f.radius.begin(), f.radius.begin() + n, keyed.radius.begin());
+				std::copy(f.color.begin(), f.color.begin() + n, keyed.color.begin());
+				float loX, hiX, loY, hiY;
+				Percentiles(f.x, n, loX, hiX);
+				Percentiles(f.y, n, loY, hiY);
+				float marginX = (hiX - loX) * BOUNDS_MARGIN + 1, marginY = (hiY - loY) * BOUNDS_MARGIN + 1;
+				minX = loX - marginX; maxX = hiX + marginX;
+				minY = loY - marginY; maxY = hiY + marginY;
+				sx = Trajectory::QUANT_MAX / (maxX - minX);
+				sy = Trajectory::QUANT_MAX / (maxY - minY);
+				FindOutliers(f);
+			}
+			q.resize(2 * n);
+			for (uint32_t i = 0; i < n; i++) {
+				q[2 * i] = uint16_t(lroundf(std::min(std::max((f.x[i] - minX) * sx, 0.0f), float(Trajectory::QUANT_MAX))));
+				q[2 * i + 1] = uint16_t(lroundf(std::min(std::max((f.y[i] - minY) * sy, 0.0f), float(Trajectory::QUANT_MAX))));
+			}
+		}
+
+		void FindOutliers(const Trajectory::Frame &f) {
+			outliers.clear();
+			for (uint32_t i = 0; i < f.count; i++) {
+				if (!(f.x[i] >= minX && f.x[i] <= maxX && f.y[i] >= minY && f.y[i] <= maxY)) {
+					outliers.push_back(i);
+				}
+			}
+		}
+
+		//1st and 99th percentile, plain min and max for small counts
+		void Percentiles(const std::vector<float> &v, uint32_t n, float &lo, float &hi) {
+			if (n == 0) {
+				lo = hi = 0;
+				return;
+			}
+			sorted.assign(v.begin(), v.begin() + n);
+			size_t cut = n / 100;
+			std::nth_element(sorted.begin(), sorted.begin() + cut, sorted.end());
+			lo = sorted[cut];
+			std::nth_element(sorted.begin(), sorted.begin() + (n - 1 - cut), sorted.end());
+			hi = sorted[n - 1 - cut];
+		}
+
+		void Encode(Connection &c, const Trajectory::Frame &f) {
+			uint32_t n = f.count;
+			bool key = c.epoch != epoch || c.sinceKey >= KEY_INTERVAL;
+			c.out.resize(5); //length and type, filled in below
+			c.out[4] = key ? KEY : DELTA;
+			Trajectory::PutU64(c.out, f.step);
+			if (key) {
+				Trajectory::PutU32(c.out, n);
+				Trajectory::PutF32(c.out, minX); Trajectory::PutF32(c.out, minY);
+				Trajectory::PutF32(c.out, maxX); Trajectory::PutF32(c.out, maxY);
+				for (uint32_t i = 0; i < n; i++) {
+					Trajectory::PutVarint(c.out, uint32_t(f.radius[i]));
+					Trajectory::PutVarint(c.out, Trajectory::ZigZag(f.mass[i]));
+					Trajectory::PutU32(c.out, f.color[i]);
+				}
+				for (uint32_t i = 0; i < 2 * n; i++) {
+					Trajectory::PutU16(c.out, q[i]);
+				}
+				c.epoch = epoch;
+				c.sinceKey = 0;
+			}
+			else {
+				for (uint32_t i = 0; i < 2 * n; i++) {
+					Trajectory::PutVarint(c.out, Trajectory::ZigZag(int16_t(uint16_t(q[i] - c.q[i]))));
+				}
+				c.sinceKey++;
+			}
+			Trajectory::PutVarint(c.out, outliers.size());
+			for (uint32_t i : outliers) {
+				Trajectory::PutVarint(c.out, i);
+				Trajectory::PutF32(c.out, f.x[i]);
+				Trajectory::PutF32(c.out, f.y[i]);
+			}
+			c.q = q;
+			uint32_t payload = uint32_t(c.out.size() - 4);
+			memcpy(c.out.data(), &payload, 4); //little endian like the rest of the format
+		}
+	};
+
+	//connects to a Server and decodes on a background thread, the viewer takes the newest frame with Read()
+	class Client {
+	public:
+		~Client() {
+			Close();
+		}
+
+		bool Connect(const std::string &host, int port) {
+			Close();
+#if defined(__linux__)
+			addrinfo hints = {};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			addrinfo* found = nullptr;
+			if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) {
+				return false;
+			}
+			for (addrinfo* a = found; a != nullptr && fd < 0; a = a->ai_next) {
+				fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+				if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+					close(fd);
+					fd = -1;
+				}
+			}
+			freeaddrinfo(found);
+			if (fd < 0) {
+				return false;
+			}
+
+			uint8_t greeting[8];
+			if (!ReadExact(greeting, 8) || memcmp(greeting, MAGIC, 4) != 0) {
+				close(fd);
+				fd = -1;
+				return false;
+			}
+			const uint8_t* p = greeting + 4;
+			if (Trajectory::GetU32(p) != VERSION) {
+				close(fd);
+				fd = -1;
+				return false;
+			}
+			connected = true;
+			thread = std::thread(&Client::ReceiveThread, this);
+			return true;
+#else
+			(void)host;
+			(void)port;
+			return false;
+#endif
+		}
+
+		void Close() {
+#if defined(__linux__)
+			if (fd >= 0) {
+				shutdown(fd, SHUT_RDWR); //wakes the receive thread
+			}
+			if (thread.joinable()) {
+				thread.join();
+			}
+			if (fd >= 0) {
+				close(fd);
+			}
+#endif
+			fd = -1;
+			connected = false;
+		}
+
+		//false once the server went away
+		bool IsConnected() {
+			return connected;
+		}
+
+		//copies the newest frame into b if there is one the caller has not seen yet
+		bool Read(std::vector<Body2D> &b, uint64_t &step) {
+			std::lock_guard<std::mutex> lock(latestMutex);
+			if (!fresh) {
+				return false;
+			}
+			fresh = false;
+			int len = latest.count;
+			b.resize(len);
+			for (int counter = 0; counter < len; counter++) {
+				b[counter] = Body2D(latest.x[counter], latest.y[counter], 0, 0, 0, 0, latest.mass[counter], latest.radius[counter], latest.color[counter]);
+			}
+			step = latest.step;
+			return true;
+		}
+
+		uint64_t FramesReceived() { return framesReceived; }
+		uint64_t BytesReceived() { return bytesReceived; }
+
+	private:
+		int fd = -1;
+		std::thread thread;
+		std::atomic<bool> connected{ false };
+		std::atomic<uint64_t> framesReceived{ 0 }, bytesReceived{ 0 };
+
+		std::mutex latestMutex;
+		Trajectory::Frame latest;
+		bool fresh = false;
+
+		//receive thread state
+		Trajectory::Frame decoded;
+		std::vector<uint16_t> q;
+		float minX = 0, minY = 0, maxX = 0, maxY = 0;
+		bool haveKey = false;
+
+		bool ReadExact(uint8_t* to, size_t bytes) {
+#if defined(__linux__)
+			while (bytes > 0) {
+				ssize_t n = recv(fd, to, bytes, 0);
+				if (n <= 0) {
+					if (n < 0 && errno == EINTR) {
+						continue;
+					}
+					return false;
+				}
+				to += n;
+				bytes -= n;
+				bytesReceived += n;
+			}
+			return true;
+#else
+			(void)to;
+			(void)bytes;
+			return false;
+#endif
+		}
+
+		void ReceiveThread() {
+			std::vector<uint8_t> message;
+			while (true) {
+				uint8_t header[5];
+				if (!ReadExact(header, 5)) {
+					break;
+				}
+				uint32_t payload;
+				memcpy(&payload, header, 4);
+				if (payload < 1 || payload > MAX_MESSAGE_BYTES) {
+					break;
+				}
+				message.resize(payload - 1);
+				if (!ReadExact(message.data(), message.size()) || !Decode(header[4], message)) {
+					break;
+				}
+				framesReceived++;
+
+				std::lock_guard<std::mutex> lock(latestMutex);
+				std::swap(latest, decoded); //both keep their storage
+				decoded.Resize(latest.count);
+				decoded.count = latest.count;
+				std::copy(latest.mass.begin(), latest.mass.begin() + latest.count, decoded.mass.begin());
+				std::copy(latest.radius.begin(), latest.radius.begin() + latest.count, decoded.radius.begin());
+				std::copy(latest.color.begin(), latest.color.begin() + latest.count, decoded.color.begin());
+				fresh = true;
+			}
+			connected = false;
+		}
+
+		bool Decode(uint8_t type, const std::vector<uint8_t> &message) {
+			const uint8_t* p = message.data();
+			const uint8_t* end = p + message.size();
+			if (message.size() < 8 || (type != KEY && type != DELTA) || (type == DELTA && !haveKey)) {
+				return false;
+			}
+			decoded.step = Trajectory::GetU64(p);
+			uint32_t n = decoded.count;
+			if (type == KEY) {
+				if (end - p < 20) {
+					return false;
+				}
+				n = Trajectory::GetU32(p);
+				minX = Trajectory::GetF32(p); minY = Trajectory::GetF32(p);
+				maxX = Trajectory::GetF32(p); maxY = Trajectory::GetF32(p);
+				if (size_t(n) * MIN_KEY_BODY_BYTES > size_t(end - p)) {
+					return false; //more bodies than the message can hold, do not allocate for them
+				}
+				decoded.Resize(n);
+				for (uint32_t i = 0; i < n; i++) {
+					decoded.radius[i] = int(Trajectory::GetVarint(p, end));
+					decoded.mass[i] = Trajectory::UnZigZag(uint32_t(Trajectory::GetVarint(p, end)));
+					if (end - p < 4) {
+						return false;
+					}
+					decoded.color[i] = Trajectory::GetU32(p);
+				}
+				if (size_t(end - p) < 4 * size_t(n)) {
+					return false;
+				}
+				q.resize(2 * n);
+				for (uint32_t i = 0; i < 2 * n; i++) {
+					q[i] = Trajectory::GetU16(p);
+				}
+				haveKey = true;
+			}
+			else {
+				for (uint32_t i = 0; i < 2 * n; i++) {
+					q[i] = uint16_t(q[i] + Trajectory::UnZigZag(uint32_t(Trajectory::GetVarint(p, end))));
+				}
+			}
+
+			float stepX = (maxX - minX) / Trajectory::QUANT_MAX, stepY = (maxY - minY) / Trajectory::QUANT_MAX;
+			for (uint32_t i = 0; i < n; i++) {
+				decoded.x[i] = minX + q[2 * i] * stepX;
+				decoded.y[i] = minY + q[2 * i + 1] * stepY;
+			}
+			uint64_t count = Trajectory::GetVarint(p, end);
+			for (uint64_t counter = 0; counter < count; counter++) {
+				uint64_t i = Trajectory::GetVarint(p, end);
+				if (i >= n || end - p < 8) {
+					return false;
+				}
+				decoded.x[i] = Trajectory::GetF32(p);
+				decoded.y[i] = Trajectory::GetF32(p);
+			}
+			return true;
+		}
+	};
+}
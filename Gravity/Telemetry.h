@@ -0,0 +1,175 @@
+#pragma once
+#include "Physics.h"
+#include "SpscRing.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+//Telemetry from the frame loop without touching a stream on the render thread.
+//Push() copies a fixed size record into a lock-free ring and returns, a background thread drains the ring
+//to a csv file, or to the console as one summary line per record that carries an energy sample.
+//When the drain thread falls behind the record is dropped and counted, Push() never waits.
+//Energy is O(n^2), so the drain thread computes it too, from a copy of the bodies handed over with the record.
+struct TelemetryRecord {
+	uint64_t step = 0;
+	double time = 0; //seconds since start
+	float stepMs = 0; //wall time of the physics this frame
+	int32_t bodies = 0;
+	int32_t merges = 0; //collisions resolved this frame
+	double energy = NAN; //NAN when not sampled, filled in by the drain thread for records pushed with bodies
+};
+
+class Telemetry {
+public:
+	static const size_t RING_RECORDS = 4096;
+
+	Telemetry() : ring(RING_RECORDS) {}
+
+	~Telemetry() {
+		Close();
+	}
+
+	//an empty path writes to the console
+	bool Open(const std::string &path = "") {
+		Close();
+		if (path.empty()) {
+			out = stdout;
+		}
+		else {
+			out = fopen(path.c_str(), "w");
+			if (out == nullptr) {
+				return false;
+			}
+			fprintf(out, "step,time,step_ms,bodies,merges,energy\n");
+		}
+		csv = !path.empty();
+		running = true;
+		drain = std::thread(&Telemetry::DrainThread, this);
+		return true;
+	}
+
+	//writes everything still queued
+	void Close() {
+		if (!drain.joinable()) {
+			return;
+		}
+		running = false;
+		drain.join();
+		if (out != stdout) {
+			fclose(out);
+		}
+		out = nullptr;
+	}
+
+	bool IsOpen() {
+		return drain.joinable();
+	}
+
+	//safe from one producer thread only, returns false if the record was dropped
+	bool Push(const TelemetryRecord &record) {
+		TelemetryRecord* slot = ring.BeginPush();
+		if (slot == nullptr) {
+			dropped++;
+			return false;
+		}
+		*slot = record;
+		ring.CommitPush();
+		pushed++;
+		return true;
+	}
+
+	//same, and the drain thread samples the energy of b into the record. the copy is O(n), when the last
+	//sample is still being computed this one is pushed without energy and false is returned
+	bool Push(const TelemetryRecord &record, const std::vector<Body2D> &b) {
+		if (sampling.load(std::memory_order_acquire)) {
+			Push(record);
+			return false;
+		}
+		TelemetryRecord* slot = ring.BeginPush();
+		if (slot == nullptr) {
+			dropped++;
+			return false;
+		}
+		snapshot = b;
+		sampleRecord = pushed;
+		sampling.store(true, std::memory_order_release);
+		*slot = record;
+		ring.CommitPush();
+		pushed++;
+		return true;
+	}
+
+	uint64_t Dropped() { return dropped; }
+
+private:
+	SpscRing<TelemetryRecord> ring;
+	std::thread drain;
+	std::atomic<bool> running{ false };
+	std::atomic<uint64_t> dropped{ 0 };
+	FILE* out = nullptr;
+	bool csv = false;
+
+	uint64_t pushed = 0, popped = 0; //records through the ring, counted by each side
+	//owned by the drain thread while sampling is set
+	std::vector<Body2D> snapshot;
+	uint64_t sampleRecord = 0;
+	std::atomic<bool> sampling{ false };
+
+	//console summary, accumulated between lines
+	int frames = 0, merges = 0;
+	double stepMs = 0;
+
+	void DrainThread() {
+		while (true) {
+			bool stopping = !running; //read before the ring so records pushed before Close() are never lost
+			TelemetryRecord* r = ring.Front();
+			if (r == nullptr) {
+				if (stopping) {
+					break;
+				}
+				fflush(out);
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+			if (sampling.load(std::memory_order_acquire) && popped == sampleRecord) {
+				r->energy = Body2D::TotalEnergy(snapshot);
+				sampling.store(false, std::memory_order_release);
+			}
+			if (csv) {
+				WriteCsv(*r);
+			}
+			else {
+				WriteSummary(*r);
+			}
+			ring.Pop();
+			popped++;
+		}
+		fflush(out);
+	}
+
+	void WriteCsv(const TelemetryRecord &r) {
+		fprintf(out, "%llu,%.4f,%.4f,%d,%d,", (unsigned long long)r.step, r.time, r.stepMs, r.bodies, r.merges);
+		if (!std::isnan(r.energy)) {
+			fprintf(out, "%.9g", r.energy);
+		}
+		fprintf(out, "\n");
+	}
+
+	void WriteSummary(const TelemetryRecord &r) {
+		frames++;
+		merges += r.merges;
+		stepMs += r.stepMs;
+		if (std::isnan(r.energy)) {
+			return;
+		}
+		fprintf(out, " %.0f seconds, step %llu, %d bodies, %d merges, %.3f ms/step, energy %.6g\n", r.time,
+			(unsigned long long)r.step, r.bodies, merges, stepMs / frames, r.energy);
+		frames = 0;
+		merges = 0;
+		stepMs = 0;
+	}
+};
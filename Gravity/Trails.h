@@ -0,0 +1,211 @@
+#pragma once
+#include "Physics.h"
+#include "Raster.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+//Orbit trails for every body out of one fixed block of memory.
+//Every body has a ring of the same number of points in one pool, the budget split between however many bodies there
+//are, so more bodies make every trail shorter instead of using more memory, and with fewer than MIN_TRAIL_POINTS a
+//body there are no trails at all. A position is only kept when the path has turned away from the direction it left
+//the last kept point in by more than the tolerance, or the segment has grown too long. Straight stretches cost a
+//couple of points and the ring's length goes where the orbit bends, at any number of steps per frame.
+class Trails {
+public:
+	static const int DEFAULT_BUDGET = 1 << 20; //points over all bodies, 8 bytes each
+	static const int MAX_TRAIL_POINTS = 512;
+	static const int MIN_TRAIL_POINTS = 8;
+	static const int MAX_SEGMENT_TOLERANCES = 64; //a segment is kept once it is this many tolerances long
+	static const int OLDEST_BRIGHTNESS = 64; //of 256, the newest segment has the body's own colour
+
+	Trails() = default;
+	Trails(const Trails&) = delete; //the pool is the whole point, copying it would double it
+	Trails& operator=(const Trails&) = delete;
+
+	//points over all bodies, trails are cleared
+	void SetBudget(int points) {
+		budget = std::max(0, points);
+		Clear();
+	}
+
+	void Clear() {
+		bodies = 0;
+		capacity = 0;
+		points.clear();
+		rings.clear();
+	}
+
+	//follows bodies removed by moving the last body into their row, as Body2D::ResolveCollisions and DeleteBodyAt
+	//do, rows in the order they were removed. each trail stays with its body
+	void Remove(const std::vector<int> &rows) {
+		for (int row : rows) {
+			if (row < 0 || row >= bodies) {
+				Clear(); //not the bodies these trails were recorded for
+				return;
+			}
+			int last = bodies - 1;
+			if (capacity > 0) {
+				if (row != last) {
+					std::copy_n(points.begin() + size_t(last) * capacity, capacity, points.begin() + size_t(row) * capacity);
+					rings[row] = rings[last];
+				}
+				points.resize(size_t(last) * capacity);
+				rings.resize(last);
+			}
+			bodies = last;
+		}
+	}
+
+	//takes the positions after a step. tolerance is in world units, how far the drawn trail may stray from the path
+	void Record(const std::vector<Body2D> &b, float tolerance) {
+		int len = b.size();
+		if (len != bodies) {
+			Resize(len);
+		}
+		if (capacity == 0 || !(tolerance > 0)) {
+			return;
+		}
+		float tol2 = tolerance * tolerance;
+		float maxSegment = tolerance * MAX_SEGMENT_TOLERANCES;
+		float maxSegment2 = maxSegment * maxSegment;
+		for (int counter = 0; counter < len; counter++) {
+			const Body2D &body = b[counter];
+			if (!body.active || !std::isfinite(body.pos.x) || !std::isfinite(body.pos.y)) {
+				continue;
+			}
+			Ring &r = rings[counter];
+			Point x = { body.pos.x, body.pos.y };
+			if (r.count == 0) {
+				Push(counter, x);
+				r.pending = x;
+				r.heading = Point{ 0, 0 };
+				continue;
+			}
+			Point p = Last(counter);
+			float ex = x.x - p.x, ey = x.y - p.y;
+			float headingLen2 = r.heading.x * r.heading.x + r.heading.y * r.heading.y;
+			if (headingLen2 == 0) {
+				r.heading = Point{ ex, ey }; //stays 0 until the body moves
+				r.pending = x;
+				continue;
+			}
+			//how far x is off the line the body left p on, an arc's chord strays about a quarter of that
+			float off = r.heading.x * ey - r.heading.y * ex;
+			if (off * off > tol2 * headingLen2 || ex * ex + ey * ey > maxSegment2) {
+				if (r.pending.x != p.x || r.pending.y != p.y) {
+					Push(counter, r.pending);
+					r.heading = Point{ x.x - r.pending.x, x.y - r.pending.y };
+				}
+				else {
+					Push(counter, x); //a single step that far, nothing in between to keep
+					r.heading = Point{ 0, 0 };
+				}
+			}
+			r.pending = x;
+		}
+	}
+
+	//every trail from its oldest point to the body, older segments dimmer. one pass over the pool into the pixels
+	void Draw(const Raster::Target &t, const std::vector<Body2D> &b, float zoom, float offsetX, float offsetY) {
+		if (capacity == 0 || t.data == nullptr) {
+			return;
+		}
+		int len = std::min(int(b.size()), bodies);
+		for (int counter = 0; counter < len; counter++) {
+			const Body2D &body = b[counter];
+			const Ring &r = rings[counter];
+			if (!body.active || r.count == 0) {
+				continue;
+			}
+			const Point* ring = points.data() + size_t(counter) * capacity;
+			int start = (r.head + capacity - r.count) % capacity;
+			float px = ring[start].x * zoom + offsetX, py = ring[start].y * zoom + offsetY;
+			for (int k = 1; k <= r.count; k++) {
+				float qx, qy;
+				if (k < r.count) {
+					const Point &q = ring[(start + k) % capacity];
+					qx = q.x * zoom + offsetX;
+					qy = q.y * zoom + offsetY;
+				}
+				else {
+					qx = body.pos.x * zoom + offsetX;
+					qy = body.pos.y * zoom + offsetY;
+				}
+				int brightness = OLDEST_BRIGHTNESS + (256 - OLDEST_BRIGHTNESS) * k / r.count;
+				Raster::DrawLine(t, px, py, qx, qy, Fade(body.color, brightness));
+				px = qx;
+				py = qy;
+			}
+		}
+	}
+
+	int Capacity() { return capacity; } //points per body, 0 when there are too many bodies for trails
+	size_t Bytes() { return points.capacity() * sizeof(Point) + rings.capacity() * sizeof(Ring); }
+
+private:
+	struct Point {
+		float x, y;
+	};
+
+	struct Ring {
+		int head = 0; //next slot written
+		int count = 0;
+		Point pending = { 0, 0 }; //latest position, kept once the path turns away from it
+		Point heading = { 0, 0 }; //direction the body left the last kept point in
+	};
+
+	int budget = DEFAULT_BUDGET;
+	int bodies = 0, capacity = 0;
+	std::vector<Point> points; //body i owns [i * capacity, (i + 1) * capacity)
+	std::vector<Ring> rings;
+
+	static uint32_t Fade(uint32_t color, int brightness) {
+		uint32_t r = (color & 0xFF) * brightness >> 8, g = ((color >> 8) & 0xFF) * brightness >> 8, b = ((color >> 16) & 0xFF) * brightness >> 8;
+		return r | (g << 8) | (b << 16) | (color & 0xFF000000);
+	}
+
+	Point Last(int body) {
+		return points[size_t(body) * capacity + (rings[body].head + capacity - 1) % capacity];
+	}
+
+	void Push(int body, Point p) {
+		Ring &r = rings[body];
+		points[size_t(body) * capacity + r.head] = p;
+		r.head = (r.head + 1) % capacity;
+		r.count = std::min(r.count + 1, capacity);
+	}
+
+	//more bodies repack the pool keeping each trail's newest points. fewer bodies that Remove() did not hear about
+	//are a new run or deletions from elsewhere, the rows no longer match, so the trails start over. merges leave the
+	//capacity as it is, the next growth resizes it
+	void Resize(int len) {
+		int fit = len > 0 ? budget / len : 0;
+		int newCapacity = fit < MIN_TRAIL_POINTS ? 0 : std::min(fit, int(MAX_TRAIL_POINTS));
+		if (len < bodies || newCapacity == 0 || capacity == 0) {
+			points.assign(size_t(len) * newCapacity, Point{ 0, 0 });
+			rings.assign(newCapacity > 0 ? len : 0, Ring());
+		}
+		else if (newCapacity == capacity) {
+			points.resize(size_t(len) * capacity);
+			rings.resize(len);
+		}
+		else {
+			std::vector<Point> repacked(size_t(len) * newCapacity);
+			for (int counter = 0; counter < bodies; counter++) {
+				Ring &r = rings[counter];
+				int kept = std::min(r.count, newCapacity);
+				for (int k = 0; k < kept; k++) {
+					repacked[size_t(counter) * newCapacity + k] = points[size_t(counter) * capacity + (r.head + capacity - kept + k) % capacity];
+				}
+				r.count = kept;
+				r.head = kept % newCapacity;
+			}
+			points.swap(repacked);
+			rings.resize(len);
+		}
+		bodies = len;
+		capacity = newCapacity;
+	}
+};
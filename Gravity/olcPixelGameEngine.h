@@ -246,7 +246,7 @@ int main()
 #define UNUSED(x) (void)(x)
 
 
-#if !defined(OLC_GFX_OPENGL33) && !defined(OLC_GFX_DIRECTX10)
+#if !defined(OLC_GFX_OPENGL33) && !defined(OLC_GFX_DIRECTX10) && !defined(OLC_GFX_SOFTWARE)
 	#define OLC_GFX_OPENGL10
 #endif
 
@@ -261,6 +261,9 @@ namespace olc
 	constexpr uint8_t  nMouseButtons = 5;
 	constexpr uint8_t  nDefaultAlpha = 0xFF;
 	constexpr uint32_t nDefaultPixel = (nDefaultAlpha << 24);
+	constexpr int32_t  nDirtyTileShift = 5; // Sprites track changes in tiles of 32x32 pixels
+	constexpr uint8_t  nDirtyUpload = 1;    // Tile changed since the texture was last updated
+	constexpr uint8_t  nDirtyDrawn = 2;     // Tile may differ from the last Clear() colour
 	enum rcode { FAIL = 0, OK = 1, NO_FILE = -1 };
 
 	
@@ -447,6 +450,18 @@ namespace olc
 		Pixel* GetData();
 		Pixel *pColData = nullptr;
 		Mode modeSample = Mode::NORMAL;
+
+	public:
+		// Which tiles were written, so a layer only uploads and clears what changed.
+		// Anything writing pColData directly must mark what it wrote.
+		void MarkDirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1); // Inclusive, clipped
+		void MarkAllDirty();
+		void MarkUploaded(); // Call once the texture has been updated
+		std::vector<uint8_t> vDirtyTiles;
+		int32_t nDirtyCols = 0;
+		int32_t nDirtyRows = 0;
+		bool bCleared = false; // Tiles without nDirtyDrawn hold pClearColour
+		Pixel pClearColour;
 	};
 
 	// O------------------------------------------------------------------------------O
@@ -494,6 +509,7 @@ namespace olc
 	class Renderer
 	{
 	public:
+		virtual ~Renderer() = default;                      // Deleted through std::unique_ptr<Renderer>
 		virtual void       PrepareDevice() = 0;
 		virtual olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) = 0;
 		virtual olc::rcode DestroyDevice() = 0;
@@ -501,18 +517,23 @@ namespace olc
 		virtual void       PrepareDrawing() = 0;
 		virtual void       DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) = 0;
 		virtual void       DrawDecalQuad(const olc::DecalInstance& decal) = 0;
+		virtual void       DrawDecalQuads(const olc::DecalInstance* decals, size_t count) { for (size_t i = 0; i < count; i++) DrawDecalQuad(decals[i]); }
 		virtual uint32_t   CreateTexture(const uint32_t width, const uint32_t height) = 0;
 		virtual void       UpdateTexture(uint32_t id, olc::Sprite* spr) = 0;
+		virtual void       UpdateTextureDirty(uint32_t id, olc::Sprite* spr) { UpdateTexture(id, spr); }
 		virtual uint32_t   DeleteTexture(const uint32_t id) = 0;
 		virtual void       ApplyTexture(uint32_t id) = 0;
 		virtual void       UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) = 0;
 		virtual void       ClearBuffer(olc::Pixel p, bool bDepth) = 0;
+		virtual olc::Sprite* GetFrame() { return nullptr; } // Last frame displayed, if it is kept in memory
+		virtual void       KeepFrames(bool keep) { UNUSED(keep); } // Renderers drawing elsewhere read frames back for GetFrame()
 		static olc::PixelGameEngine* ptrPGE;
 	};
 	
 	class Platform
 	{
 	public:
+		virtual ~Platform() = default;
 		virtual olc::rcode ApplicationStartUp() = 0;
 		virtual olc::rcode ApplicationCleanUp() = 0;
 		virtual olc::rcode ThreadStartUp() = 0;
@@ -835,6 +856,7 @@ namespace olc
 		pColData = new Pixel[width * height];
 		for (int32_t i = 0; i < width*height; i++)
 			pColData[i] = Pixel();
+		MarkAllDirty();
 	}
 
 	Sprite::~Sprite()
@@ -849,6 +871,7 @@ namespace olc
 			is.read((char*)&width, sizeof(int32_t));
 			is.read((char*)&height, sizeof(int32_t));
 			pColData = new Pixel[width * height];
+			MarkAllDirty();
 			is.read((char*)pColData, (size_t)width * (size_t)height * sizeof(uint32_t));
 		};
 
@@ -923,6 +946,8 @@ namespace olc
 		if (x >= 0 && x < width && y >= 0 && y < height)
 		{
 			pColData[y*width + x] = p;
+			if (!vDirtyTiles.empty())
+				vDirtyTiles[(y >> nDirtyTileShift) * nDirtyCols + (x >> nDirtyTileShift)] = nDirtyUpload | nDirtyDrawn;
 			return true;
 		}
 		else
@@ -961,6 +986,27 @@ namespace olc
 	Pixel* Sprite::GetData()
 	{ return pColData; }
 
+	void Sprite::MarkDirty(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+	{
+		if (vDirtyTiles.empty()) return;
+		x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+		x1 = std::min(x1, width - 1); y1 = std::min(y1, height - 1);
+		for (int32_t ty = y0 >> nDirtyTileShift; ty <= y1 >> nDirtyTileShift && x0 <= x1; ty++)
+			std::fill(vDirtyTiles.begin() + ty * nDirtyCols + (x0 >> nDirtyTileShift),
+				vDirtyTiles.begin() + ty * nDirtyCols + (x1 >> nDirtyTileShift) + 1, uint8_t(nDirtyUpload | nDirtyDrawn));
+	}
+
+	void Sprite::MarkAllDirty()
+	{
+		nDirtyCols = (width + (1 << nDirtyTileShift) - 1) >> nDirtyTileShift;
+		nDirtyRows = (height + (1 << nDirtyTileShift) - 1) >> nDirtyTileShift;
+		vDirtyTiles.assign(size_t(nDirtyCols) * size_t(nDirtyRows), nDirtyUpload | nDirtyDrawn);
+		bCleared = false;
+	}
+
+	void Sprite::MarkUploaded()
+	{ for (auto& tile : vDirtyTiles) tile &= ~nDirtyUpload; }
+
 
 	// O------------------------------------------------------------------------------O
 	// | olc::Decal IMPLEMENTATION                                                   |
@@ -1537,9 +1583,31 @@ namespace olc
 
 	void PixelGameEngine::Clear(Pixel p)
 	{
+		Sprite* target = GetDrawTarget();
+		Pixel* m = target->GetData();
+		if (target->bCleared && target->pClearColour == p && !target->vDirtyTiles.empty())
+		{
+			// Same colour as last time, so only the tiles drawn on since need it again
+			int32_t nTile = 1 << nDirtyTileShift;
+			for (int32_t ty = 0; ty < target->nDirtyRows; ty++)
+				for (int32_t tx = 0; tx < target->nDirtyCols; tx++)
+				{
+					uint8_t& tile = target->vDirtyTiles[ty * target->nDirtyCols + tx];
+					if (!(tile & nDirtyDrawn)) continue;
+					tile = nDirtyUpload;
+					int32_t x0 = tx * nTile, w = std::min(nTile, target->width - x0);
+					for (int32_t y = ty * nTile; y < std::min((ty + 1) * nTile, target->height); y++)
+						std::fill_n(m + y * target->width + x0, w, p);
+				}
+			return;
+		}
+
 		int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
-		Pixel* m = GetDrawTarget()->GetData();
 		for (int i = 0; i < pixels; i++) m[i] = p;
+		target->MarkAllDirty();
+		for (auto& tile : target->vDirtyTiles) tile = nDirtyUpload;
+		target->bCleared = true;
+		target->pClearColour = p;
 	}
 
 	void PixelGameEngine::ClearBuffer(Pixel p, bool bDepth)
@@ -2225,15 +2293,15 @@ namespace olc
 					renderer->ApplyTexture(layer->nResID);
 					if (layer->bUpdate)
 					{
-						renderer->UpdateTexture(layer->nResID, layer->pDrawTarget);
+						renderer->UpdateTextureDirty(layer->nResID, layer->pDrawTarget);
+						layer->pDrawTarget->MarkUploaded();
 						layer->bUpdate = false;
 					}
 
 					renderer->DrawLayerQuad(layer->vOffset, layer->vScale, layer->tint);
 
 					// Display Decals in order for this layer
-					for (auto& decal : layer->vecDecalInstance)
-						renderer->DrawDecalQuad(decal);
+					renderer->DrawDecalQuads(layer->vecDecalInstance.data(), layer->vecDecalInstance.size());
 					layer->vecDecalInstance.clear();
 				}
 				else
@@ -2350,6 +2418,12 @@ namespace olc
 	private:
 		glDeviceContext_t glDeviceContext = 0;
 		glRenderContext_t glRenderContext = 0;
+		std::vector<float> vBatchPos, vBatchUV;
+		std::vector<uint8_t> vBatchColour;
+		std::map<uint32_t, olc::vi2d> mapTextureSize; // Storage glTexImage2D last allocated
+		bool bKeepFrames = false;
+		olc::Sprite* pFrame = nullptr; // Read back before every swap while bKeepFrames
+		olc::vi2d vViewportPos, vViewportSize;
 
 	#if defined(__linux__) || defined(__FreeBSD__)
 		X11::Display*				 olc_Display = nullptr;
@@ -2430,11 +2504,15 @@ namespace olc
 			glXMakeCurrent(olc_Display, None, NULL);
 			glXDestroyContext(olc_Display, glDeviceContext);
 		#endif
+			delete pFrame;
+			pFrame = nullptr;
 			return olc::rcode::OK;
 		}
 
 		void DisplayFrame() override
 		{
+			if (bKeepFrames) ReadFrame();
+
 		#if defined(_WIN32)
 			SwapBuffers(glDeviceContext);
 		#endif	
@@ -2477,6 +2555,42 @@ namespace olc
 			glEnd();
 		}
 
+		// Consecutive decals sharing a texture go to the GPU as one vertex array draw
+		void DrawDecalQuads(const olc::DecalInstance* decals, size_t count) override
+		{
+			size_t start = 0;
+			while (start < count)
+			{
+				size_t end = start + 1;
+				while (end < count && decals[end].decal->id == decals[start].decal->id) end++;
+
+				vBatchPos.clear(); vBatchUV.clear(); vBatchColour.clear();
+				for (size_t i = start; i < end; i++)
+				{
+					const olc::DecalInstance& decal = decals[i];
+					for (int v = 0; v < 4; v++)
+					{
+						vBatchPos.insert(vBatchPos.end(), { decal.pos[v].x, decal.pos[v].y });
+						vBatchUV.insert(vBatchUV.end(), { decal.uv[v].x, decal.uv[v].y, 0.0f, decal.w[v] });
+						vBatchColour.insert(vBatchColour.end(), { decal.tint.r, decal.tint.g, decal.tint.b, decal.tint.a });
+					}
+				}
+
+				glBindTexture(GL_TEXTURE_2D, decals[start].decal->id);
+				glEnableClientState(GL_VERTEX_ARRAY);
+				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+				glEnableClientState(GL_COLOR_ARRAY);
+				glVertexPointer(2, GL_FLOAT, 0, vBatchPos.data());
+				glTexCoordPointer(4, GL_FLOAT, 0, vBatchUV.data());
+				glColorPointer(4, GL_UNSIGNED_BYTE, 0, vBatchColour.data());
+				glDrawArrays(GL_QUADS, 0, GLsizei(4 * (end - start)));
+				glDisableClientState(GL_COLOR_ARRAY);
+				glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+				glDisableClientState(GL_VERTEX_ARRAY);
+				start = end;
+			}
+		}
+
 		uint32_t CreateTexture(const uint32_t width, const uint32_t height) override
 		{
 			uint32_t id = 0;
@@ -2491,12 +2605,71 @@ namespace olc
 		uint32_t DeleteTexture(const uint32_t id) override
 		{
 			glDeleteTextures(1, &id);			
+			mapTextureSize.erase(id);
 			return id;
 		}
 
 		void UpdateTexture(uint32_t id, olc::Sprite* spr) override
 		{
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
+			mapTextureSize[id] = { spr->width, spr->height };
+		}
+
+		// Only the changed tiles go up, into the texture storage allocated by UpdateTexture. Runs of
+		// dirty tiles in a row are one upload, and rows with the same single run are joined
+		void UpdateTextureDirty(uint32_t id, olc::Sprite* spr) override
+		{
+			auto size = mapTextureSize.find(id);
+			if (size == mapTextureSize.end() || size->second.x != spr->width || size->second.y != spr->height || spr->vDirtyTiles.empty())
+			{
+				UpdateTexture(id, spr);
+				return;
+			}
+
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->width);
+			auto Upload = [&](int32_t c0, int32_t c1, int32_t r0, int32_t r1)
+			{
+				int32_t x = c0 << nDirtyTileShift, y = r0 << nDirtyTileShift;
+				int32_t w = std::min((c1 + 1) << nDirtyTileShift, spr->width) - x;
+				int32_t h = std::min((r1 + 1) << nDirtyTileShift, spr->height) - y;
+				glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
+				glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
+			};
+
+			const int32_t nMergeGap = 2; // Clean tiles between two runs that are cheaper to send than another call
+			int32_t pc0 = 0, pc1 = -1, pr0 = 0, pr1 = 0; // Pending rectangle of tiles, none while pc1 < pc0
+			std::vector<std::pair<int32_t, int32_t>> runs;
+			for (int32_t ty = 0; ty < spr->nDirtyRows; ty++)
+			{
+				runs.clear();
+				const uint8_t* row = spr->vDirtyTiles.data() + ty * spr->nDirtyCols;
+				for (int32_t tx = 0; tx < spr->nDirtyCols; tx++)
+				{
+					if (!(row[tx] & nDirtyUpload)) continue;
+					if (!runs.empty() && tx - runs.back().second <= nMergeGap + 1) runs.back().second = tx;
+					else runs.push_back({ tx, tx });
+				}
+
+				if (runs.size() == 1 && pc1 >= pc0 && runs[0].first == pc0 && runs[0].second == pc1 && pr1 == ty - 1)
+				{
+					pr1 = ty;
+					continue;
+				}
+				if (pc1 >= pc0) Upload(pc0, pc1, pr0, pr1);
+				pc1 = -1;
+				if (runs.size() == 1)
+				{
+					pc0 = runs[0].first; pc1 = runs[0].second; pr0 = pr1 = ty;
+				}
+				else
+					for (auto& run : runs) Upload(run.first, run.second, ty, ty);
+			}
+			if (pc1 >= pc0) Upload(pc0, pc1, pr0, pr1);
+
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+			glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 		}
 
 		void ApplyTexture(uint32_t id) override
@@ -2514,6 +2687,31 @@ namespace olc
 		void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override
 		{
 			glViewport(pos.x, pos.y, size.x, size.y);
+			vViewportPos = pos;
+			vViewportSize = size;
+		}
+
+		void KeepFrames(bool keep) override
+		{ bKeepFrames = keep; }
+
+		olc::Sprite* GetFrame() override
+		{ return bKeepFrames ? pFrame : nullptr; }
+
+		// The viewport of the back buffer, flipped so the top row comes first like a sprite. GL 1.0
+		// has no pixel buffer objects, so this waits for the frame to finish drawing
+		void ReadFrame()
+		{
+			if (pFrame == nullptr || pFrame->width != vViewportSize.x || pFrame->height != vViewportSize.y)
+			{
+				delete pFrame;
+				pFrame = new olc::Sprite(vViewportSize.x, vViewportSize.y);
+			}
+			glReadBuffer(GL_BACK);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(vViewportPos.x, vViewportPos.y, pFrame->width, pFrame->height, GL_RGBA, GL_UNSIGNED_BYTE, pFrame->GetData());
+			for (int32_t y = 0; y < pFrame->height / 2; y++)
+				std::swap_ranges(pFrame->GetData() + y * pFrame->width, pFrame->GetData() + (y + 1) * pFrame->width,
+					pFrame->GetData() + (pFrame->height - 1 - y) * pFrame->width);
 		}
 	};
 }
@@ -2522,6 +2720,238 @@ namespace olc
 // | END RENDERER: OpenGL 1.0 (the original, the best...)                         |
 // O------------------------------------------------------------------------------O
 
+// O------------------------------------------------------------------------------O
+// | START RENDERER: Software (offscreen, no display or GPU)                      |
+// O------------------------------------------------------------------------------O
+#if defined(OLC_GFX_SOFTWARE)
+#if defined(__linux__) || defined(__FreeBSD__)
+	#include <png.h>
+#endif
+
+namespace olc
+{
+	// Composites layers and decals on the CPU into a frame in memory, the way Renderer_OGL10
+	// does on the GPU: nearest texel, repeating textures, tint multiplied in, alpha blended.
+	// Paired with Platform_Headless there is no window, so it runs where there is no display.
+	class Renderer_Software : public olc::Renderer
+	{
+	private:
+		struct Texture
+		{
+			int32_t width = 0;
+			int32_t height = 0;
+			std::vector<uint32_t> data;
+		};
+
+		std::map<uint32_t, Texture> mapTextures;
+		uint32_t nNextTexture = 1;
+		uint32_t nApplied = 0;
+		olc::Sprite* pBack = nullptr;  // Being drawn
+		olc::Sprite* pFront = nullptr; // Last displayed
+		std::vector<int32_t> vColumns;
+
+		static void Blend(uint32_t& dst, uint32_t texel, const olc::Pixel& tint)
+		{
+			olc::Pixel s(texel);
+			if (tint.n != olc::WHITE.n)
+				s = olc::Pixel(uint8_t(s.r * tint.r / 255), uint8_t(s.g * tint.g / 255), uint8_t(s.b * tint.b / 255), uint8_t(s.a * tint.a / 255));
+			if (s.a == 0) return;
+			if (s.a == 255) { dst = s.n; return; }
+			olc::Pixel d(dst);
+			uint32_t a = s.a, c = 255 - s.a;
+			dst = olc::Pixel(uint8_t((s.r * a + d.r * c) / 255), uint8_t((s.g * a + d.g * c) / 255),
+				uint8_t((s.b * a + d.b * c) / 255), uint8_t((s.a * a + d.a * c) / 255)).n;
+		}
+
+		static int32_t Wrap(float f, int32_t size)
+		{
+			int32_t i = int32_t(std::floor(f * size)) % size;
+			return i < 0 ? i + size : i;
+		}
+
+		// Twice the signed area on the left of a->b, the inside of a polygon wound positively
+		static float Edge(const olc::vf2d& a, const olc::vf2d& b, float x, float y)
+		{ return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x); }
+
+		// Pixels on an edge belong to one side only, so quads sharing an edge never blend twice
+		static bool Inside(const olc::vf2d& a, const olc::vf2d& b, float e)
+		{ return e > 0 || (e == 0 && (b.y - a.y > 0 || (b.y - a.y == 0 && b.x - a.x < 0))); }
+
+	public:
+		~Renderer_Software()
+		{
+			delete pBack;
+			delete pFront;
+		}
+
+		void PrepareDevice() override
+		{}
+
+		olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) override
+		{ UNUSED(params); UNUSED(bFullScreen); UNUSED(bVSYNC); return olc::rcode::OK; }
+
+		olc::rcode DestroyDevice() override
+		{
+			mapTextures.clear();
+			return olc::rcode::OK;
+		}
+
+		void DisplayFrame() override
+		{ std::swap(pBack, pFront); }
+
+		void PrepareDrawing() override
+		{}
+
+		void DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) override
+		{
+			auto tex = mapTextures.find(nApplied);
+			if (pBack == nullptr || tex == mapTextures.end() || tex->second.data.empty()) return;
+			const Texture& t = tex->second;
+			uint32_t* out = (uint32_t*)pBack->GetData();
+			vColumns.resize(pBack->width);
+			for (int32_t x = 0; x < pBack->width; x++)
+				vColumns[x] = Wrap(offset.x + scale.x * (x + 0.5f) / pBack->width, t.width);
+			for (int32_t y = 0; y < pBack->height; y++)
+			{
+				const uint32_t* row = t.data.data() + size_t(Wrap(offset.y + scale.y * (y + 0.5f) / pBack->height, t.height)) * t.width;
+				uint32_t* dst = out + size_t(y) * pBack->width;
+				for (int32_t x = 0; x < pBack->width; x++)
+					Blend(dst[x], row[vColumns[x]], tint);
+			}
+		}
+
+		// The quad is split along 0-2 like GL splits it, texture coordinates are interpolated
+		// per triangle and divided by w for warped decals
+		void DrawDecalQuad(const olc::DecalInstance& decal) override
+		{
+			auto tex = mapTextures.find(decal.decal->id);
+			if (pBack == nullptr || tex == mapTextures.end() || tex->second.data.empty()) return;
+			const Texture& t = tex->second;
+
+			int order[4] = { 0, 1, 2, 3 };
+			olc::vf2d p[4];
+			for (int i = 0; i < 4; i++)
+				p[i] = { (decal.pos[i].x + 1.0f) * 0.5f * pBack->width, (1.0f - decal.pos[i].y) * 0.5f * pBack->height };
+			float area = 0;
+			for (int i = 0; i < 4; i++) area += p[i].x * p[(i + 1) & 3].y - p[(i + 1) & 3].x * p[i].y;
+			if (area == 0) return;
+			if (area < 0)
+			{
+				std::swap(order[1], order[3]);
+				std::swap(p[1], p[3]);
+			}
+
+			float minX = std::min(std::min(p[0].x, p[1].x), std::min(p[2].x, p[3].x));
+			float maxX = std::max(std::max(p[0].x, p[1].x), std::max(p[2].x, p[3].x));
+			float minY = std::min(std::min(p[0].y, p[1].y), std::min(p[2].y, p[3].y));
+			float maxY = std::max(std::max(p[0].y, p[1].y), std::max(p[2].y, p[3].y));
+			int32_t x0 = std::max(0, int32_t(std::floor(minX))), x1 = std::min(pBack->width - 1, int32_t(std::ceil(maxX)));
+			int32_t y0 = std::max(0, int32_t(std::floor(minY))), y1 = std::min(pBack->height - 1, int32_t(std::ceil(maxY)));
+
+			uint32_t* out = (uint32_t*)pBack->GetData();
+			for (int32_t y = y0; y <= y1; y++)
+				for (int32_t x = x0; x <= x1; x++)
+				{
+					float px = x + 0.5f, py = y + 0.5f;
+					float e[4];
+					bool inside = true;
+					for (int i = 0; i < 4 && inside; i++)
+					{
+						e[i] = Edge(p[i], p[(i + 1) & 3], px, py);
+						inside = Inside(p[i], p[(i + 1) & 3], e[i]);
+					}
+					if (!inside) continue;
+
+					// Triangle 0,1,2 lies right of the diagonal 0->2 and 0,2,3 left of it
+					int a = 0, b, c;
+					float diagonal = Edge(p[0], p[2], px, py);
+					if (diagonal >= 0) { b = 2; c = 3; }
+					else { b = 1; c = 2; }
+					float la = Edge(p[b], p[c], px, py), lb = Edge(p[c], p[a], px, py), lc = Edge(p[a], p[b], px, py);
+					float sum = la + lb + lc;
+					if (sum == 0) continue;
+					la /= sum; lb /= sum; lc /= sum;
+					const int ia = order[a], ib = order[b], ic = order[c];
+					float s = la * decal.uv[ia].x + lb * decal.uv[ib].x + lc * decal.uv[ic].x;
+					float v = la * decal.uv[ia].y + lb * decal.uv[ib].y + lc * decal.uv[ic].y;
+					float q = la * decal.w[ia] + lb * decal.w[ib] + lc * decal.w[ic];
+					if (q == 0) continue;
+					uint32_t texel = t.data[size_t(Wrap(v / q, t.height)) * t.width + Wrap(s / q, t.width)];
+					Blend(out[size_t(y) * pBack->width + x], texel, decal.tint);
+				}
+		}
+
+		uint32_t CreateTexture(const uint32_t width, const uint32_t height) override
+		{
+			UNUSED(width); UNUSED(height); // Sized by the first UpdateTexture
+			uint32_t id = nNextTexture++;
+			mapTextures[id] = Texture();
+			return id;
+		}
+
+		uint32_t DeleteTexture(const uint32_t id) override
+		{
+			mapTextures.erase(id);
+			return id;
+		}
+
+		void UpdateTexture(uint32_t id, olc::Sprite* spr) override
+		{
+			Texture& t = mapTextures[id];
+			t.width = spr->width;
+			t.height = spr->height;
+			t.data.assign((uint32_t*)spr->GetData(), (uint32_t*)spr->GetData() + size_t(spr->width) * size_t(spr->height));
+		}
+
+		// Copies only the changed tiles, the same ones Renderer_OGL10 would upload
+		void UpdateTextureDirty(uint32_t id, olc::Sprite* spr) override
+		{
+			Texture& t = mapTextures[id];
+			if (t.width != spr->width || t.height != spr->height || spr->vDirtyTiles.empty())
+			{
+				UpdateTexture(id, spr);
+				return;
+			}
+			const uint32_t* src = (uint32_t*)spr->GetData();
+			for (int32_t ty = 0; ty < spr->nDirtyRows; ty++)
+				for (int32_t tx = 0; tx < spr->nDirtyCols; tx++)
+				{
+					if (!(spr->vDirtyTiles[ty * spr->nDirtyCols + tx] & nDirtyUpload)) continue;
+					int32_t x = tx << nDirtyTileShift, w = std::min(1 << nDirtyTileShift, spr->width - x);
+					for (int32_t y = ty << nDirtyTileShift; y < std::min((ty + 1) << nDirtyTileShift, spr->height); y++)
+						std::copy_n(src + size_t(y) * spr->width + x, w, t.data.begin() + size_t(y) * t.width + x);
+				}
+		}
+
+		void ApplyTexture(uint32_t id) override
+		{ nApplied = id; }
+
+		void ClearBuffer(olc::Pixel p, bool bDepth) override
+		{
+			UNUSED(bDepth);
+			if (pBack != nullptr) std::fill_n((uint32_t*)pBack->GetData(), size_t(pBack->width) * size_t(pBack->height), p.n);
+		}
+
+		// The frame is the size of the view, there is no window around it
+		void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(pos);
+			if (pBack != nullptr && pBack->width == size.x && pBack->height == size.y) return;
+			delete pBack;
+			delete pFront;
+			pBack = new olc::Sprite(size.x, size.y);
+			pFront = new olc::Sprite(size.x, size.y);
+		}
+
+		olc::Sprite* GetFrame() override
+		{ return pFront; }
+	};
+}
+#endif
+// O------------------------------------------------------------------------------O
+// | END RENDERER: Software (offscreen, no display or GPU)                        |
+// O------------------------------------------------------------------------------O
+
 
 // O------------------------------------------------------------------------------O
 // | START PLATFORM: MICROSOFT WINDOWS XP, VISTA, 7, 8, 10                        |
@@ -2769,6 +3199,7 @@ namespace olc
 		width = bmp->GetWidth();
 		height = bmp->GetHeight();
 		pColData = new Pixel[width * height];
+		MarkAllDirty();
 
 		for (int y = 0; y < height; y++)
 			for (int x = 0; x < width; x++)
@@ -2796,6 +3227,7 @@ namespace olc
 #if defined(__linux__) || defined(__FreeBSD__)
 namespace olc
 {
+#if !defined(OLC_GFX_SOFTWARE)
 	class Platform_Linux : public olc::Platform
 	{
 	private:
@@ -3009,6 +3441,7 @@ namespace olc
 			return olc::OK;
 		}
 	};
+#endif
 
 	void pngReadStream(png_structp pngPtr, png_bytep data, png_size_t length)
 	{
@@ -3059,6 +3492,7 @@ namespace olc
 			////////////////////////////////////////////////////////////////////////////
 			// Create sprite array
 			pColData = new Pixel[width * height];
+			MarkAllDirty();
 			// Iterate through image rows, converting into sprite format
 			for (int y = 0; y < height; y++)
 			{
@@ -3114,10 +3548,68 @@ namespace olc
 // | END PLATFORM: LINUX                                                          |
 // O------------------------------------------------------------------------------O
 
+// O------------------------------------------------------------------------------O
+// | START PLATFORM: HEADLESS                                                     |
+// O------------------------------------------------------------------------------O
+#if defined(OLC_GFX_SOFTWARE)
+namespace olc
+{
+	// No window and no input, Start() returns once OnUserUpdate() returns false
+	class Platform_Headless : public olc::Platform
+	{
+	public:
+		virtual olc::rcode ApplicationStartUp() override
+		{ return olc::rcode::OK; }
+
+		virtual olc::rcode ApplicationCleanUp() override
+		{ return olc::rcode::OK; }
+
+		virtual olc::rcode ThreadStartUp() override
+		{ return olc::rcode::OK; }
+
+		virtual olc::rcode ThreadCleanUp() override
+		{
+			renderer->DestroyDevice();
+			return olc::OK;
+		}
+
+		virtual olc::rcode CreateGraphics(bool bFullScreen, bool bEnableVSYNC, const olc::vi2d& vViewPos, const olc::vi2d& vViewSize) override
+		{
+			if (renderer->CreateDevice({}, bFullScreen, bEnableVSYNC) == olc::rcode::OK)
+			{
+				renderer->UpdateViewport(vViewPos, vViewSize);
+				return olc::rcode::OK;
+			}
+			else
+				return olc::rcode::FAIL;
+		}
+
+		virtual olc::rcode CreateWindowPane(const olc::vi2d& vWindowPos, olc::vi2d& vWindowSize, bool bFullScreen) override
+		{ UNUSED(vWindowPos); UNUSED(vWindowSize); UNUSED(bFullScreen); return olc::rcode::OK; }
+
+		virtual olc::rcode SetWindowTitle(const std::string& s) override
+		{ UNUSED(s); return olc::rcode::OK; }
+
+		virtual olc::rcode StartSystemEventLoop() override
+		{ return olc::rcode::OK; }
+
+		virtual olc::rcode HandleSystemEvent() override
+		{ return olc::rcode::OK; }
+	};
+}
+#endif
+// O------------------------------------------------------------------------------O
+// | END PLATFORM: HEADLESS                                                       |
+// O------------------------------------------------------------------------------O
+
 namespace olc
 {
 	void PixelGameEngine::olc_ConfigureSystem()
 	{
+#if defined(OLC_GFX_SOFTWARE)
+		platform = std::make_unique<olc::Platform_Headless>();
+		renderer = std::make_unique<olc::Renderer_Software>();
+#else
 #if defined(_WIN32)
 		platform = std::make_unique<olc::Platform_Windows>();
 #endif
@@ -3125,6 +3617,7 @@ namespace olc
 #if defined(__linux__) || defined(__FreeBSD__)
 		platform = std::make_unique<olc::Platform_Linux>();
 #endif
+#endif
 
 #if defined(OLC_GFX_OPENGL10)
 		renderer = std::make_unique<olc::Renderer_OGL10>();
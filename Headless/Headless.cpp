@@ -0,0 +1,20 @@
+//Headless batch runner, drives the physics without a window or OpenGL context.
+//Only the simulation headers are included here, so this links against nothing but the C++ runtime.
+//
+//usage: Headless [--steps N | --time T] [--dt seconds] [--integrator euler|leapfrog] [--bodies N] [--seed S] [--threads N]
+//                [--snapshot-every K] [--snapshot-dir dir] [--stats file.csv] [--stats-every K]
+//                [--record file.g2dt] [--publish name] [--serve port] [--serve-rate hz] [--counters] [--on-collision stop|merge] [--eject-radius r]
+//                [--processes P] [--theta t] [--rebalance-every K]
+//       Headless --ensemble N [--steps N | --time T] [--dt seconds] [--integrator euler|leapfrog] [--bodies N] [--seed S] [--threads N]
+//                [--mass-spread f] [--vel-spread f] [--on-collision stop|merge] [--eject-radius r] [--results file.csv]
+#include "HeadlessRunner.h"
+
+int main(int argc, char* argv[])
+{
+	HeadlessRunner runner;
+	if (!runner.ParseArgs(argc, argv)) {
+		HeadlessRunner::PrintUsage();
+		return 1;
+	}
+	return runner.Run();
+}
@@ -0,0 +1,551 @@
+#pragma once
+#include "../Gravity/Domain.h"
+#include "../Gravity/Ensemble.h"
+#include "../Gravity/PerfCounters.h"
+#include "../Gravity/Physics.h"
+#include "../Gravity/Recorder.h"
+#include "../Gravity/SharedState.h"
+#include "../Gravity/Stream.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Options and step loop of the headless runner, shared by Headless and Sweep.
+//Simulate() is the quiet part: it steps b from its current state and returns how the run ended,
+//Run() sets up the scenario and the output files around it and prints the summary.
+
+//how a Simulate() call ended
+struct RunResult {
+	const char* status = "finished"; //finished, collided or ejected
+	uint64_t steps = 0;
+	size_t bodies = 0;
+	double startEnergy = 0, endEnergy = 0; //only with trackEnergy, both are O(n^2)
+	double seconds = 0;
+};
+
+class HeadlessRunner {
+public:
+	//run length, whichever is given last on the command line wins
+	uint64_t maxSteps = 1000;
+	double maxTime = 0; //simulated seconds, 0 means use maxSteps
+	float dt = 1 / 60.0f; //fixed timestep, the viewer uses the frame time instead
+	bool leapfrog = false; //euler is what the viewer uses
+
+	//scenario, 0 bodies means the three body setup from Body2D::InitBodies
+	int bodies = 0;
+	unsigned int seed = 1;
+	int threads = 1;
+
+	//output
+	uint64_t snapshotEvery = 0;
+	std::string snapshotDir = "snapshots";
+	std::string statsPath;
+	uint64_t statsEvery = 100;
+	std::string recordPath;
+	bool counters = false; //hardware counters per phase, printed at the end (Linux only)
+	std::string publishName; //shared memory segment every step is published to, see SharedState.h
+	int servePort = 0; //remote viewers connect here, see Stream.h
+	float serveRate = 30; //frames per second sent to them
+
+	//early stop. onCollision is "stop" or "merge", empty means stop for ensembles and merge, like the viewer, otherwise
+	std::string onCollision;
+	float ejectRadius = 0; //a body this far from the centre of mass ends the run, 0 disables
+	bool trackEnergy = false;
+
+	//ensemble mode, N perturbed copies of the scenario stepped together instead of one run
+	int ensemble = 0;
+	float massSpread = 0, velSpread = 0; //relative, uniform in [1 - spread, 1 + spread]
+	std::string resultsPath;
+
+	//domain decomposition, the run split over this many processes by Domain::Simulation
+	int processes = 1;
+	float theta = 0;
+	uint64_t rebalanceEvery = 50;
+
+	std::vector<Body2D> b;
+
+	bool ParseArgs(int argc, char* argv[]) {
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (arg == "--help" || arg == "-h") {
+				return false;
+			}
+			if (arg == "--counters") {
+				counters = true;
+				continue;
+			}
+			if (!hasValue) {
+				std::cerr << "missing value for " << arg << "\n";
+				return false;
+			}
+
+			std::string value = argv[++i];
+			if (arg == "--steps") {
+				maxSteps = std::stoull(value);
+				maxTime = 0;
+			}
+			else if (arg == "--time") {
+				maxTime = std::stod(value);
+			}
+			else if (arg == "--dt") {
+				dt = std::stof(value);
+			}
+			else if (arg == "--integrator") {
+				if (value != "euler" && value != "leapfrog") {
+					std::cerr << "unknown integrator " << value << "\n";
+					return false;
+				}
+				leapfrog = value == "leapfrog";
+			}
+			else if (arg == "--bodies") {
+				bodies = std::stoi(value);
+			}
+			else if (arg == "--seed") {
+				seed = std::stoul(value);
+			}
+			else if (arg == "--threads") {
+				threads = std::stoi(value);
+			}
+			else if (arg == "--snapshot-every") {
+				snapshotEvery = std::stoull(value);
+			}
+			else if (arg == "--snapshot-dir") {
+				snapshotDir = value;
+			}
+			else if (arg == "--stats") {
+				statsPath = value;
+			}
+			else if (arg == "--stats-every") {
+				statsEvery = std::stoull(value);
+			}
+			else if (arg == "--record") {
+				recordPath = value;
+			}
+			else if (arg == "--publish") {
+				publishName = value;
+			}
+			else if (arg == "--serve") {
+				servePort = std::stoi(value);
+			}
+			else if (arg == "--serve-rate") {
+				serveRate = std::stof(value);
+			}
+			else if (arg == "--ensemble") {
+				ensemble = std::stoi(value);
+			}
+			else if (arg == "--mass-spread") {
+				massSpread = std::stof(value);
+			}
+			else if (arg == "--vel-spread") {
+				velSpread = std::stof(value);
+			}
+			else if (arg == "--on-collision") {
+				if (value != "stop" && value != "merge") {
+					std::cerr << "unknown collision rule " << value << "\n";
+					return false;
+				}
+				onCollision = value;
+			}
+			else if (arg == "--eject-radius") {
+				ejectRadius = std::stof(value);
+			}
+			else if (arg == "--results") {
+				resultsPath = value;
+			}
+			else if (arg == "--processes") {
+				processes = std::stoi(value);
+			}
+			else if (arg == "--theta") {
+				theta = std::stof(value);
+			}
+			else if (arg == "--rebalance-every") {
+				rebalanceEvery = std::stoull(value);
+			}
+			else {
+				std::cerr << "unknown option " << arg << "\n";
+				return false;
+			}
+		}
+		return dt > 0;
+	}
+
+	static void PrintUsage() {
+		std::cerr << "usage: Headless [--steps N | --time T] [--dt seconds] [--integrator euler|leapfrog] [--bodies N] [--seed S] [--threads N]\n"
+			<< "                [--snapshot-every K] [--snapshot-dir dir] [--stats file.csv] [--stats-every K]\n"
+			<< "                [--record file.g2dt] [--publish name] [--serve port] [--serve-rate hz] [--counters] [--on-collision stop|merge] [--eject-radius r]\n"
+			<< "                [--processes P] [--theta t] [--rebalance-every K]\n"
+			<< "       Headless --ensemble N [--steps N | --time T] [--dt seconds] [--integrator euler|leapfrog] [--bodies N] [--seed S] [--threads N]\n"
+			<< "                [--mass-spread f] [--vel-spread f] [--on-collision stop|merge] [--eject-radius r] [--results file.csv]\n";
+	}
+
+	void InitScenario() {
+		b.clear();
+		if (bodies > 0) {
+			Body2D::InitRandomBodies(b, bodies, seed);
+		}
+		else {
+			Body2D::InitBodies(b);
+		}
+	}
+
+	uint64_t StepCount() {
+		return maxTime > 0 ? uint64_t(maxTime / dt + 0.5) : maxSteps;
+	}
+
+	int Run() {
+		InitScenario();
+		if (ensemble > 0) {
+			return RunEnsemble();
+		}
+		if (processes > 1) {
+			return RunDomains();
+		}
+
+		if (snapshotEvery > 0) {
+			std::filesystem::create_directories(snapshotDir);
+		}
+		if (!statsPath.empty()) {
+			stats.open(statsPath);
+			if (!stats.is_open()) {
+				std::cerr << "could not open " << statsPath << "\n";
+				return 1;
+			}
+			stats << "step,time,bodies,energy,angular_momentum,step_ms\n";
+		}
+		if (!recordPath.empty() && !recorder.Open(recordPath)) {
+			std::cerr << "could not open " << recordPath << "\n";
+			return 1;
+		}
+		if (!publishName.empty() && !publisher.Open(publishName, std::max<uint32_t>(1024, uint32_t(b.size())))) {
+			std::cerr << "could not create shared memory segment " << publishName << "\n";
+			return 1;
+		}
+		if (servePort > 0 && !server.Open(servePort, serveRate)) {
+			std::cerr << "could not listen on port " << servePort << "\n";
+			return 1;
+		}
+		if (counters && !perf.Open()) {
+			std::cerr << "hardware counters not available, running without them\n";
+		}
+
+		RunResult result = Simulate();
+		recorder.Close();
+		publisher.Close();
+		if (server.IsOpen()) {
+			std::cout << server.FramesSent() << " frames streamed, " << server.FramesDropped() << " dropped, "
+				<< server.BytesSent() / 1048576.0 << " MB\n";
+		}
+		server.Close();
+		stats.close();
+
+		std::cout << result.steps << " steps, " << result.bodies << " bodies left, " << result.seconds << " s wall, "
+			<< (result.seconds > 0 ? result.steps / result.seconds : 0) << " steps/s";
+		if (result.status != std::string("finished")) {
+			std::cout << ", stopped: " << result.status;
+		}
+		std::cout << "\n";
+		if (perf.IsOpen()) {
+			PrintCounters();
+		}
+		return 0;
+	}
+
+	//steps b from its current state, writing whatever outputs Run() opened
+	RunResult Simulate() {
+		RunResult result;
+		bool stopOnCollision = onCollision == "stop";
+		if (trackEnergy) {
+			result.startEnergy = Body2D::TotalEnergy(b);
+		}
+
+		uint64_t steps = StepCount();
+		std::vector<CollisionPair> pairs;
+		if (leapfrog) {
+			Body2D::ComputeGravity(b, pairs, threads);
+			Body2D::ResolveCollisions(b, pairs);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		double stepSeconds = 0; //wall time spent in physics since the last stats row
+		for (uint64_t step = 1; step <= steps; step++) {
+			auto t0 = std::chrono::steady_clock::now();
+
+			bodyFrames += b.size();
+			pairs.clear();
+			if (leapfrog) {
+				CounterValues c0 = perf.Read();
+				Body2D::UpdateLeapfrog(b, dt, pairs, threads);
+				CounterValues c1 = perf.Read();
+				if (stopOnCollision && !pairs.empty()) {
+					result.status = "collided";
+					break;
+				}
+				Body2D::ResolveCollisions(b, pairs);
+				phaseCounters[0] += c1 - c0;
+				phaseCounters[1] += perf.Read() - c1;
+			}
+			else {
+				//same order as Graphics::OnUserUpdate, Body2D::UpdateGravity split so collisions can be seen
+				CounterValues c0 = perf.Read();
+				Body2D::ComputeGravity(b, pairs, threads);
+				if (stopOnCollision && !pairs.empty()) {
+					result.status = "collided";
+					break;
+				}
+				Body2D::ResolveCollisions(b, pairs);
+				CounterValues c1 = perf.Read();
+				Body2D::UpdateVelandPos(b, dt);
+				phaseCounters[0] += c1 - c0;
+				phaseCounters[1] += perf.Read() - c1;
+			}
+			result.steps = step;
+
+			stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+			if (recorder.IsOpen()) {
+				RecordFrame(recorder, step);
+			}
+			if (publisher.IsOpen()) {
+				publisher.Publish(b, step, step * dt);
+			}
+			if (server.IsOpen()) {
+				server.Publish(b, step);
+			}
+			if (snapshotEvery > 0 && step % snapshotEvery == 0) {
+				WriteSnapshot(step);
+			}
+			if (stats.is_open() && statsEvery > 0 && (step % statsEvery == 0 || step == steps)) {
+				WriteStats(step, stepSeconds);
+				stepSeconds = 0;
+			}
+			if (ejectRadius > 0 && Ejected()) {
+				result.status = "ejected";
+				break;
+			}
+		}
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.bodies = b.size();
+		if (trackEnergy) {
+			result.endEnergy = Body2D::TotalEnergy(b);
+		}
+		return result;
+	}
+
+	//one row per system with its outcome, and the throughput in system steps per second on stdout
+	int RunEnsemble() {
+		std::ofstream results;
+		if (!resultsPath.empty()) {
+			results.open(resultsPath);
+			if (!results.is_open()) {
+				std::cerr << "could not open " << resultsPath << "\n";
+				return 1;
+			}
+		}
+
+		uint64_t steps = StepCount();
+
+		Ensemble e;
+		e.stopOnCollision = onCollision != "merge";
+		e.ejectRadius = ejectRadius;
+		e.Init(b, ensemble, massSpread, velSpread, seed);
+
+		auto start = std::chrono::steady_clock::now();
+		uint64_t systemSteps = e.Run(steps, dt, leapfrog, threads);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		int outcomes[4] = { 0, 0, 0, 0 };
+		if (results.is_open()) {
+			results.precision(9);
+			results << "system,status,steps,merges,energy_start,energy_end,energy_drift\n";
+		}
+		for (int s = 0; s < e.systems; s++) {
+			outcomes[e.status[s]]++;
+			if (results.is_open()) {
+				double energy = e.Energy(s);
+				results << s << "," << Ensemble::StatusName(e.status[s]) << "," << e.steps[s] << "," << e.merges[s] << ","
+					<< e.startEnergy[s] << "," << energy << "," << (e.startEnergy[s] != 0 ? (energy - e.startEnergy[s]) / std::abs(e.startEnergy[s]) : 0) << "\n";
+			}
+		}
+
+		std::cout << e.systems << " systems of " << e.bodies << " bodies, " << systemSteps << " system steps, " << seconds << " s wall, "
+			<< (seconds > 0 ? systemSteps / seconds : 0) << " system steps/s\n"
+			<< outcomes[Ensemble::FINISHED] << " finished, " << outcomes[Ensemble::COLLIDED] << " collided, "
+			<< outcomes[Ensemble::EJECTED] << " ejected\n";
+		return 0;
+	}
+
+	//Run() with the bodies split over processes, rank 0 writes the outputs and prints the summary
+	int RunDomains() {
+		if (!recordPath.empty() || !publishName.empty() || servePort > 0 || counters || threads > 1) {
+			std::cerr << "--record, --publish, --serve, --counters and --threads cannot be used with --processes\n";
+			return 1;
+		}
+
+		std::cout.flush();
+		std::fflush(stdout);
+		Domain::Simulation d;
+		d.theta = theta;
+		d.rebalanceEvery = rebalanceEvery;
+		if (!d.Launch(processes)) {
+			std::cerr << "could not start " << processes << " processes\n";
+			return 1;
+		}
+		bool root = d.Rank() == 0;
+
+		if (root && snapshotEvery > 0) {
+			std::filesystem::create_directories(snapshotDir);
+		}
+		if (root && !statsPath.empty()) {
+			stats.open(statsPath);
+			if (stats.is_open()) {
+				stats << "step,time,bodies,energy,angular_momentum,step_ms\n";
+			}
+			else {
+				std::cerr << "could not open " << statsPath << ", running without stats\n";
+			}
+		}
+
+		RunResult result;
+		if (trackEnergy) {
+			result.startEnergy = Body2D::TotalEnergy(b);
+		}
+		bool stopOnCollision = onCollision == "stop";
+		uint64_t steps = StepCount();
+		d.Init(b);
+
+		auto start = std::chrono::steady_clock::now();
+		double stepSeconds = 0;
+		bool running = !leapfrog || d.Start(stopOnCollision);
+		for (uint64_t step = 1; running && step <= steps; step++) {
+			auto t0 = std::chrono::steady_clock::now();
+			bool more = d.Step(dt, leapfrog, stopOnCollision, ejectRadius);
+			if (more || std::string(d.status) == "ejected") {
+				result.steps = step; //the ejection test runs after the step, as in Simulate()
+			}
+			if (!more) {
+				break;
+			}
+			stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+			//every rank has to take part in a gather, so they all decide from the step number alone
+			bool statsDue = !statsPath.empty() && statsEvery > 0 && (step % statsEvery == 0 || step == steps);
+			bool snapshotDue = snapshotEvery > 0 && step % snapshotEvery == 0;
+			if (statsDue || snapshotDue) {
+				if (!d.Gather(b)) {
+					break;
+				}
+				if (root && statsDue && stats.is_open()) {
+					WriteStats(step, stepSeconds);
+				}
+				if (root && snapshotDue) {
+					WriteSnapshot(step);
+				}
+				stepSeconds = 0;
+			}
+		}
+		if (std::string(d.status) != "failed") {
+			d.Gather(b);
+		}
+		result.status = d.status;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.bodies = b.size();
+		stats.close();
+
+		if (root) {
+			std::cout << result.steps << " steps, " << result.bodies << " bodies left, " << result.seconds << " s wall, "
+				<< (result.seconds > 0 ? result.steps / result.seconds : 0) << " steps/s";
+			if (result.status != std::string("finished")) {
+				std::cout << ", stopped: " << result.status;
+			}
+			std::cout << "\n" << processes << " processes, bodies per rank";
+			for (int count : d.rankBodies) {
+				std::cout << " " << count;
+			}
+			std::cout << ", " << d.rebalances << " rebalances, " << d.migrated << " migrations, "
+				<< d.bytesSent / 1048576.0 << " MB exchanged\n";
+		}
+		return d.Finish(std::string(d.status) == "failed" ? 1 : 0);
+	}
+
+private:
+	std::ofstream stats;
+	Trajectory::Recorder recorder;
+	SharedState::Publisher publisher;
+	Stream::Server server;
+	PerfCounters perf;
+	CounterValues phaseCounters[2]; //force evaluation, then collisions or integration
+	uint64_t bodyFrames = 0; //body count summed over all steps
+
+	//same test as Ensemble, any body further than ejectRadius from the centre of mass
+	bool Ejected() {
+		double m = 0, cx = 0, cy = 0;
+		for (Body2D &body : b) {
+			m += body.mass;
+			cx += double(body.mass) * body.pos.x;
+			cy += double(body.mass) * body.pos.y;
+		}
+		if (m <= 0) {
+			return false;
+		}
+		cx /= m;
+		cy /= m;
+		for (Body2D &body : b) {
+			double dx = body.pos.x - cx, dy = body.pos.y - cy;
+			if (dx * dx + dy * dy > double(ejectRadius) * ejectRadius) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void PrintCounters() {
+		const char* names[2] = { leapfrog ? "UpdateLeapfrog" : "UpdateGravity", leapfrog ? "ResolveCollisions" : "UpdateVelandPos" };
+		std::printf("%-18s %8s %16s %18s %18s\n", "phase", "ipc", "instructions", "cache miss/body", "branch miss/body");
+		for (int phase = 0; phase < 2; phase++) {
+			CounterValues &c = phaseCounters[phase];
+			std::printf("%-18s %8.2f %16llu %18.3f %18.3f\n", names[phase], c.Ipc(), (unsigned long long)c.instructions,
+				bodyFrames > 0 ? double(c.cacheMisses) / bodyFrames : 0, bodyFrames > 0 ? double(c.branchMisses) / bodyFrames : 0);
+		}
+	}
+
+	void RecordFrame(Trajectory::Recorder &recorder, uint64_t step) {
+		Trajectory::Frame* f = recorder.WaitFrame();
+		int len = b.size();
+		f->step = step;
+		f->Resize(len);
+		for (int counter = 0; counter < len; counter++) {
+			f->x[counter] = b[counter].pos.x;
+			f->y[counter] = b[counter].pos.y;
+			f->mass[counter] = b[counter].mass;
+			f->radius[counter] = b[counter].radius;
+			f->color[counter] = b[counter].color;
+		}
+		recorder.CommitFrame();
+	}
+
+	//stepSeconds is the physics wall time since the last row
+	void WriteStats(uint64_t step, double stepSeconds) {
+		uint64_t stepsInRow = (step % statsEvery == 0) ? statsEvery : step % statsEvery;
+		stats << step << "," << step * dt << "," << b.size() << "," << Body2D::TotalEnergy(b) << ","
+			<< Body2D::AngularMomentum(b) << "," << 1000 * stepSeconds / stepsInRow << "\n";
+	}
+
+	//one csv per snapshot, full precision so a run can be restarted from it
+	void WriteSnapshot(uint64_t step) {
+		std::string name = std::to_string(step);
+		name = std::string(name.size() < 9 ? 9 - name.size() : 0, '0') + name;
+		std::ofstream out(snapshotDir + "/snapshot_" + name + ".csv");
+		out.precision(9);
+		out << "x,y,vx,vy,mass,radius,color\n";
+		for (Body2D &body : b) {
+			out << body.pos.x << "," << body.pos.y << "," << body.vel.x << "," << body.vel.y << ","
+				<< body.mass << "," << body.radius << "," << body.color << "\n";
+		}
+	}
+};
@@ -0,0 +1,409 @@
+//Parameter sweeps over the headless runner, run on every core by a work stealing scheduler.
+//Every job is one HeadlessRunner with a few scenario parameters changed. Jobs that stop early
+//(--on-collision stop, --eject-radius) free their worker, which then steals from busier ones,
+//and every finished job is appended to one csv as soon as it completes.
+//
+//usage: Sweep --param name=min:max[:count] [--param ...] [--random N] [--sweep-seed S] [--workers N] [--out sweep.csv]
+//             [Headless options: --steps N | --time T, --dt, --integrator, --bodies, --seed, --threads, --on-collision, --eject-radius]
+//
+//without --random the sweep is the full grid, count evenly spaced values per parameter (1 if left out, which takes min).
+//with --random N it is N jobs, every parameter drawn uniformly from [min, max].
+//
+//parameters: dt, bodies, seed                   set before the scenario is created
+//            mass-scale, vel-scale              every body's mass or velocity multiplied
+//            body<k>.x, .y, .vx, .vy, .mass, .radius   one body of the scenario, body0 is the first
+//Body2D masses and radii are whole numbers, values for them are rounded.
+#include "../Headless/HeadlessRunner.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct SweepParam {
+	std::string name;
+	double min = 0, max = 0;
+	int count = 1;
+};
+
+//Runs jobs 0..count-1 once each. Every worker starts with a contiguous block, takes its own work from the back
+//and steals from the front of the other workers' queues once it runs dry, so neighbouring grid points
+//(which usually cost about the same) stay together and stolen jobs are the ones their owner would reach last.
+class WorkStealingScheduler {
+public:
+	void Run(int count, int workers, std::function<void(int job, int worker)> fn) {
+		workers = std::max(1, std::min(workers, count));
+		queues.clear();
+		for (int w = 0; w < workers; w++) {
+			queues.push_back(std::unique_ptr<Queue>(new Queue()));
+			int begin = int((long long)count * w / workers);
+			int end = int((long long)count * (w + 1) / workers);
+			for (int job = begin; job < end; job++) {
+				queues[w]->jobs.push_back(job);
+			}
+		}
+
+		std::vector<std::thread> threads;
+		for (int w = 0; w < workers; w++) {
+			threads.push_back(std::thread([this, w, fn]() {
+				int job;
+				while (Next(w, job)) {
+					fn(job, w);
+				}
+			}));
+		}
+		for (std::thread &t : threads) {
+			t.join();
+		}
+	}
+
+	uint64_t Steals() { return steals; }
+
+private:
+	struct Queue {
+		std::mutex m;
+		std::deque<int> jobs;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::atomic<uint64_t> steals{ 0 };
+
+	//no job ever adds another, so once every queue is empty the worker is done
+	bool Next(int worker, int &job) {
+		{
+			Queue &own = *queues[worker];
+			std::lock_guard<std::mutex> lock(own.m);
+			if (!own.jobs.empty()) {
+				job = own.jobs.back();
+				own.jobs.pop_back();
+				return true;
+			}
+		}
+		int n = int(queues.size());
+		for (int k = 1; k < n; k++) {
+			Queue &victim = *queues[(worker + k) % n];
+			std::lock_guard<std::mutex> lock(victim.m);
+			if (!victim.jobs.empty()) {
+				job = victim.jobs.front();
+				victim.jobs.pop_front();
+				steals++;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+class Sweep {
+public:
+	std::vector<SweepParam> params;
+	int randomJobs = 0; //0 means grid
+	unsigned int sweepSeed = 1;
+	int workers = std::max(1u, std::thread::hardware_concurrency());
+	std::string outPath = "sweep.csv";
+	std::vector<std::string> runnerArgs; //forwarded to HeadlessRunner::ParseArgs for every job
+
+	bool ParseArgs(int argc, char* argv[]) {
+		runnerArgs.push_back(argv[0]);
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			if (arg == "--help" || arg == "-h") {
+				return false;
+			}
+			bool ours = arg == "--param" || arg == "--random" || arg == "--sweep-seed" || arg == "--workers" || arg == "--out";
+			if (!ours) {
+				runnerArgs.push_back(arg);
+				continue;
+			}
+			if (i + 1 >= argc) {
+				std::cerr << "missing value for " << arg << "\n";
+				return false;
+			}
+
+			std::string value = argv[++i];
+			if (arg == "--param") {
+				SweepParam p;
+				if (!ParseParam(value, p)) {
+					std::cerr << "bad parameter " << value << ", expected name=min:max[:count]\n";
+					return false;
+				}
+				if (!KnownParam(p.name)) {
+					std::cerr << "unknown parameter " << p.name << "\n";
+					return false;
+				}
+				params.push_back(p);
+			}
+			else if (arg == "--random") {
+				randomJobs = std::stoi(value);
+			}
+			else if (arg == "--sweep-seed") {
+				sweepSeed = std::stoul(value);
+			}
+			else if (arg == "--workers") {
+				workers = std::stoi(value);
+			}
+			else if (arg == "--out") {
+				outPath = value;
+			}
+		}
+
+		//every job would write the same files
+		HeadlessRunner check;
+		if (!MakeRunner(check)) {
+			return false;
+		}
+		if (!check.statsPath.empty() || !check.recordPath.empty() || !check.publishName.empty() || check.servePort > 0 || check.snapshotEvery > 0 || check.counters || check.ensemble > 0 || check.processes > 1) {
+			std::cerr << "--stats, --record, --publish, --serve, --snapshot-every, --counters, --ensemble and --processes cannot be used in a sweep\n";
+			return false;
+		}
+		return !params.empty();
+	}
+
+	static void PrintUsage() {
+		std::cerr << "usage: Sweep --param name=min:max[:count] [--param ...] [--random N] [--sweep-seed S] [--workers N] [--out sweep.csv]\n"
+			<< "             [Headless options: --steps N | --time T, --dt, --integrator, --bodies, --seed, --threads, --on-collision, --eject-radius]\n"
+			<< "parameters: dt, bodies, seed, mass-scale, vel-scale, body<k>.x, body<k>.y, body<k>.vx, body<k>.vy, body<k>.mass, body<k>.radius\n";
+	}
+
+	int Run() {
+		BuildJobs();
+		out.open(outPath);
+		if (!out.is_open()) {
+			std::cerr << "could not open " << outPath << "\n";
+			return 1;
+		}
+		out.precision(9);
+		out << "job";
+		for (SweepParam &p : params) {
+			out << "," << p.name;
+		}
+		out << ",status,steps,bodies,energy_start,energy_end,energy_drift,wall_ms,worker\n";
+		out.flush();
+
+		std::cout << jobs.size() << " jobs on " << std::min(workers, int(jobs.size())) << " workers\n";
+		auto start = std::chrono::steady_clock::now();
+		WorkStealingScheduler scheduler;
+		scheduler.Run(int(jobs.size()), workers, [this](int job, int worker) { RunJob(job, worker); });
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << jobs.size() << " jobs, " << seconds << " s wall, " << (seconds > 0 ? jobs.size() / seconds : 0) << " jobs/s, "
+			<< scheduler.Steals() << " steals\n"
+			<< finished << " finished, " << collided << " collided, " << ejected << " ejected, " << invalid << " invalid\n";
+		return 0;
+	}
+
+private:
+	std::vector<std::vector<double>> jobs; //one value per parameter
+	std::ofstream out;
+	std::mutex outMutex;
+	std::atomic<int> finished{ 0 }, collided{ 0 }, ejected{ 0 }, invalid{ 0 };
+
+	static bool ParseParam(const std::string &text, SweepParam &p) {
+		size_t eq = text.find('=');
+		if (eq == std::string::npos || eq == 0) {
+			return false;
+		}
+		p.name = text.substr(0, eq);
+		std::vector<std::string> fields;
+		std::stringstream ss(text.substr(eq + 1));
+		std::string field;
+		while (std::getline(ss, field, ':')) {
+			fields.push_back(field);
+		}
+		if (fields.empty() || fields.size() > 3) {
+			return false;
+		}
+		try {
+			p.min = std::stod(fields[0]);
+			p.max = fields.size() > 1 ? std::stod(fields[1]) : p.min;
+			p.count = fields.size() > 2 ? std::stoi(fields[2]) : 1;
+		}
+		catch (const std::exception&) {
+			return false;
+		}
+		return p.count >= 1;
+	}
+
+	//checked once before any job runs, ApplyAfterInit then only fails for bodies a scenario does not have
+	static bool KnownParam(const std::string &name) {
+		if (name == "dt" || name == "bodies" || name == "seed" || name == "mass-scale" || name == "vel-scale") {
+			return true;
+		}
+		size_t k;
+		std::string field;
+		return ParseBodyParam(name, k, field) && (field == "x" || field == "y" || field == "vx" || field == "vy" || field == "mass" || field == "radius");
+	}
+
+	//body<k>.field, k in decimal digits only
+	static bool ParseBodyParam(const std::string &name, size_t &k, std::string &field) {
+		size_t dot = name.find('.');
+		if (name.compare(0, 4, "body") != 0 || dot == std::string::npos || dot == 4 || dot - 4 > 9) {
+			return false;
+		}
+		k = 0;
+		for (size_t i = 4; i < dot; i++) {
+			if (name[i] < '0' || name[i] > '9') {
+				return false;
+			}
+			k = k * 10 + size_t(name[i] - '0');
+		}
+		field = name.substr(dot + 1);
+		return true;
+	}
+
+	bool MakeRunner(HeadlessRunner &runner) {
+		std::vector<char*> argv;
+		for (std::string &arg : runnerArgs) {
+			argv.push_back(&arg[0]);
+		}
+		return runner.ParseArgs(int(argv.size()), argv.data());
+	}
+
+	void BuildJobs() {
+		jobs.clear();
+		if (randomJobs > 0) {
+			uint32_t state = sweepSeed ? sweepSeed : 1;
+			for (int j = 0; j < randomJobs; j++) {
+				std::vector<double> values;
+				for (SweepParam &p : params) {
+					//xorshift32, same as Body2D::InitRandomBodies
+					state ^= state << 13;
+					state ^= state >> 17;
+					state ^= state << 5;
+					values.push_back(p.min + (p.max - p.min) * ((state & 0xFFFFFF) / double(0x1000000)));
+				}
+				jobs.push_back(values);
+			}
+			return;
+		}
+
+		//full grid, the last parameter changes fastest
+		size_t total = 1;
+		for (SweepParam &p : params) {
+			total *= p.count;
+		}
+		for (size_t j = 0; j < total; j++) {
+			std::vector<double> values(params.size());
+			size_t rest = j;
+			for (int k = int(params.size()) - 1; k >= 0; k--) {
+				int index = int(rest % params[k].count);
+				rest /= params[k].count;
+				values[k] = params[k].count > 1 ? params[k].min + (params[k].max - params[k].min) * index / (params[k].count - 1) : params[k].min;
+			}
+			jobs.push_back(values);
+		}
+	}
+
+	void RunJob(int job, int worker) {
+		HeadlessRunner runner;
+		MakeRunner(runner);
+		runner.trackEnergy = true;
+
+		const std::vector<double> &values = jobs[job];
+		for (size_t k = 0; k < params.size(); k++) {
+			ApplyBeforeInit(runner, params[k].name, values[k]);
+		}
+		runner.InitScenario();
+		bool valid = runner.dt > 0;
+		for (size_t k = 0; k < params.size(); k++) {
+			valid = ApplyAfterInit(runner, params[k].name, values[k]) && valid;
+		}
+
+		RunResult result;
+		if (valid) {
+			result = runner.Simulate();
+			std::string status = result.status;
+			(status == "collided" ? collided : status == "ejected" ? ejected : finished)++;
+		}
+		else {
+			result.status = "invalid";
+			invalid++;
+		}
+		WriteRow(job, result, worker);
+	}
+
+	//rows go out in completion order, the job column gives the grid or sample position
+	void WriteRow(int job, const RunResult &r, int worker) {
+		double drift = r.startEnergy != 0 ? (r.endEnergy - r.startEnergy) / std::abs(r.startEnergy) : 0;
+		std::lock_guard<std::mutex> lock(outMutex);
+		out << job;
+		for (double v : jobs[job]) {
+			out << "," << v;
+		}
+		out << "," << r.status << "," << r.steps << "," << r.bodies << "," << r.startEnergy << "," << r.endEnergy << ","
+			<< drift << "," << r.seconds * 1000 << "," << worker << "\n";
+		out.flush();
+	}
+
+	static void ApplyBeforeInit(HeadlessRunner &runner, const std::string &name, double v) {
+		if (name == "dt") {
+			runner.dt = float(v);
+		}
+		else if (name == "bodies") {
+			runner.bodies = int(std::lround(v));
+		}
+		else if (name == "seed") {
+			runner.seed = (unsigned int)std::lround(v);
+		}
+	}
+
+	//false for names that are not parameters or bodies the scenario does not have
+	static bool ApplyAfterInit(HeadlessRunner &runner, const std::string &name, double v) {
+		std::vector<Body2D> &b = runner.b;
+		if (name == "dt" || name == "bodies" || name == "seed") {
+			return true;
+		}
+		if (name == "mass-scale") {
+			for (Body2D &body : b) {
+				body.mass = int(std::lround(body.mass * v));
+			}
+			return true;
+		}
+		if (name == "vel-scale") {
+			for (Body2D &body : b) {
+				body.vel.scale(float(v));
+			}
+			return true;
+		}
+
+		size_t k;
+		std::string field;
+		if (!ParseBodyParam(name, k, field) || k >= b.size()) {
+			return false;
+		}
+		if (field == "x") {
+			b[k].pos.x = float(v);
+		}
+		else if (field == "y") {
+			b[k].pos.y = float(v);
+		}
+		else if (field == "vx") {
+			b[k].vel.x = float(v);
+		}
+		else if (field == "vy") {
+			b[k].vel.y = float(v);
+		}
+		else if (field == "mass") {
+			b[k].mass = int(std::lround(v));
+		}
+		else if (field == "radius") {
+			b[k].radius = int(std::lround(v));
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	Sweep sweep;
+	if (!sweep.ParseArgs(argc, argv)) {
+		Sweep::PrintUsage();
+		return 1;
+	}
+	return sweep.Run();
+}